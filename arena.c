@@ -0,0 +1,102 @@
+#include "arena.h"
+#include <stdarg.h>
+#include <stdatomic.h>
+
+typedef struct arena_block_t {
+    struct arena_block_t *next;
+} arena_block_t;
+
+static _Atomic uint64_t heap_allocations;
+
+static void *heap_alloc(size_t size)
+{
+    atomic_fetch_add_explicit(&heap_allocations, 1, memory_order_relaxed);
+    return malloc(size);
+}
+
+uint64_t arena_heap_allocations(void)
+{
+    return atomic_load_explicit(&heap_allocations, memory_order_relaxed);
+}
+
+void arena_reserve(arena_t *a, size_t capacity)
+{
+    if (a->capacity >= capacity && a->memory)
+        return;
+    // Only valid while nothing is allocated
+    free(a->memory);
+    a->memory = heap_alloc(capacity);
+    a->capacity = a->memory ? capacity : 0;
+    a->used = 0;
+}
+
+static void free_overflow(arena_t *a)
+{
+    arena_block_t *block = a->overflow;
+    while (block) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    a->overflow = 0;
+    a->overflow_size = 0;
+}
+
+void arena_free(arena_t *a)
+{
+    free_overflow(a);
+    free(a->memory);
+    memset(a, 0, sizeof(*a));
+}
+
+void *arena_alloc(arena_t *a, size_t size, size_t align)
+{
+    if (!a->memory)
+        arena_reserve(a, a->capacity ? a->capacity : ARENA_DEFAULT_CAPACITY);
+
+    size_t offset = (a->used + align - 1) & ~(align - 1);
+    if (a->memory && offset + size <= a->capacity) {
+        a->used = offset + size;
+        if (a->used + a->overflow_size > a->peak)
+            a->peak = a->used + a->overflow_size;
+        return a->memory + offset;
+    }
+
+    // Out of space; take a block from the heap and remember to grow on reset
+    arena_block_t *block = heap_alloc(sizeof(arena_block_t) + size + align);
+    if (!block)
+        return 0;
+    block->next = a->overflow;
+    a->overflow = block;
+    a->overflow_size += size + align;
+    if (a->used + a->overflow_size > a->peak)
+        a->peak = a->used + a->overflow_size;
+    uintptr_t p = (uintptr_t)(block + 1);
+    return (void *)((p + align - 1) & ~(uintptr_t)(align - 1));
+}
+
+void arena_reset(arena_t *a)
+{
+    const bool overflowed = a->overflow != 0;
+    free_overflow(a);
+    a->used = 0;
+    if (overflowed)
+        arena_reserve(a, a->peak * 2);
+    a->peak = 0;
+}
+
+char *arena_print(arena_t *a, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    va_list measure;
+    va_copy(measure, args);
+    int length = vsnprintf(0, 0, format, measure);
+    va_end(measure);
+
+    char *str = arena_alloc(a, (size_t)(length > 0 ? length : 0) + 1, 1);
+    if (str)
+        vsnprintf(str, (size_t)length + 1, format, args);
+    va_end(args);
+    return str;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "foundation/basic.h"
+
+enum {
+    // Capacity reserved by the first allocation of a zero initialized arena
+    ARENA_DEFAULT_CAPACITY = 64 * 1024,
+};
+
+// Bump allocator. Memory is handed out linearly and released all at once
+// with `arena_reset`, or back to a mark with `arena_rewind`. A zero
+// initialized arena is ready to use.
+typedef struct arena_t {
+    uint8_t *memory;
+    size_t capacity;
+    size_t used;
+    // Highest `used` since the last reset, including overflow
+    size_t peak;
+    // Blocks taken from the heap after `memory` ran out, freed on reset
+    struct arena_block_t *overflow;
+    size_t overflow_size;
+} arena_t;
+
+// Makes sure `capacity` bytes are available without touching the heap
+void arena_reserve(arena_t *a, size_t capacity);
+void arena_free(arena_t *a);
+
+void *arena_alloc(arena_t *a, size_t size, size_t align);
+// Releases everything and grows the arena if the last use overflowed
+void arena_reset(arena_t *a);
+
+static inline size_t arena_mark(const arena_t *a)
+{
+    return a->used;
+}
+
+// Releases allocations made after `mark`; overflow blocks are kept until reset
+static inline void arena_rewind(arena_t *a, size_t mark)
+{
+    if (mark <= a->used)
+        a->used = mark;
+}
+
+char *arena_print(arena_t *a, const char *format, ...);
+
+#define arena_push_array(a, type, count) ((type *)arena_alloc((a), sizeof(type) * (count), _Alignof(type)))
+
+// Number of heap allocations made by all arenas so far. A hot path is
+// allocation free if this doesn't change while it runs.
+uint64_t arena_heap_allocations(void);
@@ -0,0 +1,204 @@
+#include "board_snapshot.h"
+#include <stdatomic.h>
+
+enum {
+    // Retired snapshots collected before scanning the readers
+    RECLAIM_BATCH = 32,
+};
+
+struct board_snapshot_slot_t {
+    _Atomic(board_snapshot_t *) current;
+    // Set when destroyed, readers that loaded the slot before may still use it
+    uint64_t retire_epoch;
+    struct board_snapshot_slot_t *next;
+};
+
+// Epoch the reader entered with, zero while not reading. Each reader gets
+// its own cache line so entering and leaving doesn't bounce between threads.
+struct snapshot_reader_t {
+    _Atomic uint64_t epoch;
+    _Atomic bool in_use;
+    uint8_t padding[64 - sizeof(uint64_t) - sizeof(bool)];
+};
+
+static snapshot_reader_t readers[MAX_SNAPSHOT_READERS];
+
+// Starts at one so that zero can mean "not reading"
+static _Atomic uint64_t global_epoch = 1;
+
+// Owned by the publishing thread
+static struct {
+    board_snapshot_t *retired;
+    board_snapshot_t *free;
+    board_snapshot_slot_t *retired_slots;
+    uint32_t num_pending;
+} writer;
+
+static struct {
+    _Atomic uint64_t num_published;
+    _Atomic uint64_t num_retired;
+    _Atomic uint64_t num_reclaimed;
+} stats;
+
+static board_snapshot_t *alloc_snapshot(void)
+{
+    board_snapshot_t *s = writer.free;
+    if (s) {
+        writer.free = s->next;
+        return s;
+    }
+    return malloc(sizeof(board_snapshot_t));
+}
+
+// Moves retired snapshots older than every active reader to the free list
+static void reclaim_snapshots(void)
+{
+    uint64_t oldest = UINT64_MAX;
+    for (uint32_t i = 0; i < MAX_SNAPSHOT_READERS; ++i) {
+        const uint64_t epoch = atomic_load(&readers[i].epoch);
+        if (epoch && epoch < oldest)
+            oldest = epoch;
+    }
+
+    uint64_t num_reclaimed = 0;
+    board_snapshot_t **link = &writer.retired;
+    while (*link) {
+        board_snapshot_t *s = *link;
+        if (s->retire_epoch < oldest) {
+            *link = s->next;
+            s->next = writer.free;
+            writer.free = s;
+            ++num_reclaimed;
+        }
+        else {
+            link = &s->next;
+        }
+    }
+
+    board_snapshot_slot_t **slot_link = &writer.retired_slots;
+    while (*slot_link) {
+        board_snapshot_slot_t *slot = *slot_link;
+        if (slot->retire_epoch < oldest) {
+            *slot_link = slot->next;
+            free(slot);
+        }
+        else {
+            slot_link = &slot->next;
+        }
+    }
+
+    writer.num_pending = 0;
+    atomic_fetch_add_explicit(&stats.num_reclaimed, num_reclaimed, memory_order_relaxed);
+}
+
+// Readers that entered before the epoch is advanced may still hold `s`,
+// later ones can only load its replacement
+static void retire_snapshot(board_snapshot_t *s)
+{
+    s->retire_epoch = atomic_fetch_add(&global_epoch, 1);
+    s->next = writer.retired;
+    writer.retired = s;
+    atomic_fetch_add_explicit(&stats.num_retired, 1, memory_order_relaxed);
+
+    if (++writer.num_pending >= RECLAIM_BATCH)
+        reclaim_snapshots();
+}
+
+static void copy_snapshot(board_snapshot_t *s, const board_component_t *board)
+{
+    s->board = *board;
+    s->board.selected_piece.id = UINT64_MAX;
+    memset(s->board.legal_move_indices, 0, sizeof(s->board.legal_move_indices));
+    s->retire_epoch = 0;
+    s->next = 0;
+}
+
+board_snapshot_slot_t *create_board_snapshot_slot(const board_component_t *board)
+{
+    board_snapshot_slot_t *slot = malloc(sizeof(board_snapshot_slot_t));
+    // Allocated directly, the free list belongs to the publishing thread
+    board_snapshot_t *s = malloc(sizeof(board_snapshot_t));
+    if (!slot || !s) {
+        free(slot);
+        free(s);
+        return 0;
+    }
+    copy_snapshot(s, board);
+    atomic_init(&slot->current, s);
+    slot->retire_epoch = 0;
+    slot->next = 0;
+    atomic_fetch_add_explicit(&stats.num_published, 1, memory_order_relaxed);
+    return slot;
+}
+
+void destroy_board_snapshot_slot(board_snapshot_slot_t *slot)
+{
+    if (!slot)
+        return;
+    // Readers still holding the slot find it empty from here on
+    board_snapshot_t *s = atomic_exchange(&slot->current, 0);
+    slot->retire_epoch = atomic_fetch_add(&global_epoch, 1);
+    slot->next = writer.retired_slots;
+    writer.retired_slots = slot;
+    if (s)
+        retire_snapshot(s);
+    else if (++writer.num_pending >= RECLAIM_BATCH)
+        reclaim_snapshots();
+}
+
+void publish_board_snapshot(board_snapshot_slot_t *slot, const board_component_t *board)
+{
+    board_snapshot_t *s = alloc_snapshot();
+    if (!s)
+        return;
+    copy_snapshot(s, board);
+
+    board_snapshot_t *old = atomic_exchange(&slot->current, s);
+    atomic_fetch_add_explicit(&stats.num_published, 1, memory_order_relaxed);
+    if (old)
+        retire_snapshot(old);
+}
+
+snapshot_reader_t *register_snapshot_reader(void)
+{
+    for (uint32_t i = 0; i < MAX_SNAPSHOT_READERS; ++i) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&readers[i].in_use, &expected, true))
+            return &readers[i];
+    }
+    return 0;
+}
+
+void unregister_snapshot_reader(snapshot_reader_t *reader)
+{
+    atomic_store(&reader->epoch, 0);
+    atomic_store(&reader->in_use, false);
+}
+
+void begin_snapshot_read(snapshot_reader_t *reader)
+{
+    // The announcement must be visible before any slot is loaded
+    atomic_store(&reader->epoch, atomic_load(&global_epoch));
+}
+
+void end_snapshot_read(snapshot_reader_t *reader)
+{
+    atomic_store_explicit(&reader->epoch, 0, memory_order_release);
+}
+
+const board_snapshot_t *load_board_snapshot(const board_snapshot_slot_t *slot)
+{
+    return atomic_load((_Atomic(board_snapshot_t *) *)&slot->current);
+}
+
+board_snapshot_stats_t board_snapshot_stats(void)
+{
+    const uint64_t num_retired = atomic_load_explicit(&stats.num_retired, memory_order_relaxed);
+    const uint64_t num_reclaimed = atomic_load_explicit(&stats.num_reclaimed, memory_order_relaxed);
+    return (board_snapshot_stats_t) {
+        .num_published = atomic_load_explicit(&stats.num_published, memory_order_relaxed),
+        .num_retired = num_retired - num_reclaimed,
+        .num_reclaimed = num_reclaimed,
+        .epoch = atomic_load(&global_epoch),
+    };
+}
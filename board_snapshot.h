@@ -0,0 +1,56 @@
+#pragma once
+#include "foundation/basic.h"
+#include "components.h"
+
+enum {
+    // Threads that may read snapshots at the same time
+    MAX_SNAPSHOT_READERS = 64,
+};
+
+// Immutable copy of the rules state of one board. Selection and other
+// input state is cleared, so `board` can be handed to the search or the
+// move generator as is.
+typedef struct board_snapshot_t {
+    board_component_t board;
+    // Global epoch when this snapshot was replaced, see `retire_snapshot`
+    uint64_t retire_epoch;
+    struct board_snapshot_t *next;
+} board_snapshot_t;
+
+// Published snapshot of one board. Lives on the heap so readers can keep
+// the pointer while the board component array is reallocated.
+typedef struct board_snapshot_slot_t board_snapshot_slot_t;
+
+// One per reading thread, see `begin_snapshot_read`
+typedef struct snapshot_reader_t snapshot_reader_t;
+
+typedef struct board_snapshot_stats_t {
+    uint64_t num_published;
+    // Snapshots waiting for readers to leave older epochs
+    uint64_t num_retired;
+    uint64_t num_reclaimed;
+    uint64_t epoch;
+} board_snapshot_stats_t;
+
+// Publishing happens on one thread at a time, the one applying moves.
+// Creating a slot is safe from any thread.
+board_snapshot_slot_t *create_board_snapshot_slot(const board_component_t *board);
+// Freed once no reader can still see it, readers loading it meanwhile get
+// null. Publishing thread only, after the last publish.
+void destroy_board_snapshot_slot(board_snapshot_slot_t *slot);
+// Replaces the published snapshot with a copy of `board`. The old one is
+// freed once no reader can still see it.
+void publish_board_snapshot(board_snapshot_slot_t *slot, const board_component_t *board);
+
+// Returns 0 when all `MAX_SNAPSHOT_READERS` are taken
+snapshot_reader_t *register_snapshot_reader(void);
+void unregister_snapshot_reader(snapshot_reader_t *reader);
+
+// Snapshots loaded between begin and end stay valid until `end_snapshot_read`.
+// Keep the section short, it holds back reclamation for all boards.
+void begin_snapshot_read(snapshot_reader_t *reader);
+void end_snapshot_read(snapshot_reader_t *reader);
+// Null once the slot is destroyed
+const board_snapshot_t *load_board_snapshot(const board_snapshot_slot_t *slot);
+
+board_snapshot_stats_t board_snapshot_stats(void);
@@ -0,0 +1,397 @@
+#include "broadcast.h"
+#include "rules_api.h"
+#include "entity.h"
+#include "foundation/log.h"
+#include <unistd.h>
+#include <errno.h>
+
+enum {
+    DELTA_MOVE = 0,
+    DELTA_GAME_STATE = 1,
+    NO_BOARD = 0xffff,
+    // Bytes of a varint holding a frame size
+    MAX_SIZE_PREFIX = 10,
+};
+
+static inline int to_square(int pos)
+{
+    return (pos & 7) + (pos >> 4) * 8;
+}
+
+static inline int from_square(int square)
+{
+    return (square & 7) + (square >> 3) * 16;
+}
+
+static bool reserve_bytes(uint8_t **buffer, size_t *capacity, size_t size)
+{
+    if (size <= *capacity)
+        return true;
+    size_t new_capacity = *capacity ? *capacity * 2 : 4096;
+    while (new_capacity < size)
+        new_capacity *= 2;
+    uint8_t *p = realloc(*buffer, new_capacity);
+    if (!p)
+        return false;
+    *buffer = p;
+    *capacity = new_capacity;
+    return true;
+}
+
+static void put_u8(broadcast_writer_t *w, uint8_t v)
+{
+    if (reserve_bytes(&w->buffer, &w->buffer_capacity, w->buffer_size + 1))
+        w->buffer[w->buffer_size++] = v;
+}
+
+static void put_varint(broadcast_writer_t *w, uint64_t v)
+{
+    do {
+        put_u8(w, (uint8_t)((v & 0x7f) | (v >= 0x80 ? 0x80 : 0)));
+        v >>= 7;
+    } while (v);
+}
+
+static void put_u16(broadcast_writer_t *w, uint16_t v)
+{
+    put_u8(w, (uint8_t)v);
+    put_u8(w, (uint8_t)(v >> 8));
+}
+
+static inline uint32_t hash_entity(uint64_t id)
+{
+    return (uint32_t)((id * 0x9e3779b97f4a7c15ull) >> 32) & (BROADCAST_BOARD_TABLE_SIZE - 1);
+}
+
+static uint16_t find_board_index(const broadcast_writer_t *w, entity_t e)
+{
+    for (uint32_t slot = hash_entity(e.id);; slot = (slot + 1) & (BROADCAST_BOARD_TABLE_SIZE - 1)) {
+        if (w->board_ids[slot] == e.id)
+            return w->board_indices[slot];
+        if (w->board_ids[slot] == UINT64_MAX)
+            return NO_BOARD;
+    }
+}
+
+static void insert_board_index(broadcast_writer_t *w, entity_t e, uint16_t index)
+{
+    uint32_t slot = hash_entity(e.id);
+    while (w->board_ids[slot] != UINT64_MAX)
+        slot = (slot + 1) & (BROADCAST_BOARD_TABLE_SIZE - 1);
+    w->board_ids[slot] = e.id;
+    w->board_indices[slot] = index;
+}
+
+broadcast_writer_t *create_broadcast_writer(entity_ctx_o *ctx, uint32_t keyframe_interval)
+{
+    broadcast_writer_t *w = calloc(1, sizeof(broadcast_writer_t));
+    if (!w)
+        return 0;
+    w->keyframe_interval = keyframe_interval ? keyframe_interval : 1;
+    w->need_keyframe = true;
+    memset(w->board_ids, 0xff, sizeof(w->board_ids));
+
+    // History before the first keyframe isn't needed
+    const move_event_ring_t *events = get_move_events(ctx);
+    if (events)
+        skip_move_events(events, &w->events);
+    return w;
+}
+
+void destroy_broadcast_writer(broadcast_writer_t *w)
+{
+    if (!w)
+        return;
+    free(w->buffer);
+    free(w);
+}
+
+bool add_broadcast_sink(broadcast_writer_t *w, int fd)
+{
+    if (w->num_sinks == BROADCAST_MAX_SINKS)
+        return false;
+    w->sinks[w->num_sinks++] = fd;
+    // The new viewer has nothing to apply deltas to
+    w->need_keyframe = true;
+    return true;
+}
+
+static void put_keyframe(broadcast_writer_t *w, entity_ctx_o *ctx)
+{
+    memset(w->board_ids, 0xff, sizeof(w->board_ids));
+    w->num_boards = 0;
+
+    // Count first, the number goes before the boards
+    const board_component_t *boards = component_data(ctx, board_id);
+    entity_t e;
+    uint32_t i = 0;
+    uint32_t num_boards = 0;
+    while (find_next_component(ctx, board_id, (1ULL << board_id), &i, &e) && num_boards < BROADCAST_MAX_BOARDS) {
+        ++num_boards;
+        ++i;
+    }
+    put_varint(w, num_boards);
+
+    i = 0;
+    while (w->num_boards < num_boards && find_next_component(ctx, board_id, (1ULL << board_id), &i, &e)) {
+        const board_component_t *board = &boards[i];
+        insert_board_index(w, e, (uint16_t)w->num_boards++);
+
+        for (int square = 0; square < 64; square += 2) {
+            const uint8_t lo = board->indices[from_square(square)];
+            const uint8_t hi = board->indices[from_square(square + 1)];
+            put_u8(w, (uint8_t)(lo | hi << 4));
+        }
+        put_u8(w, (uint8_t)(board->current_player >> 3 | board->castle_bits << 1));
+        put_u8(w, (uint8_t)board->en_passant_pos);
+        put_varint(w, board->move_count);
+        put_u8(w, board->game_state);
+        put_u8(w, board->num_white_captures);
+        put_u8(w, board->num_black_captures);
+        ++i;
+    }
+}
+
+static void write_to_sinks(broadcast_writer_t *w, const uint8_t *data, size_t size)
+{
+    for (uint32_t s = 0; s < w->num_sinks;) {
+        size_t written = 0;
+        while (written < size) {
+            const ssize_t n = write(w->sinks[s], data + written, size - written);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            written += (size_t)n;
+        }
+
+        if (written < size) {
+            log_print(LOG_WARN, "Broadcast sink %i failed, dropping it", w->sinks[s]);
+            w->sinks[s] = w->sinks[--w->num_sinks];
+            continue;
+        }
+        w->stats.bytes_sent += size;
+        ++s;
+    }
+}
+
+size_t broadcast_tick(broadcast_writer_t *w, entity_ctx_o *ctx)
+{
+    // Room for the frame size, which goes in front once known
+    if (!reserve_bytes(&w->buffer, &w->buffer_capacity, MAX_SIZE_PREFIX))
+        return 0;
+    w->buffer_size = MAX_SIZE_PREFIX;
+    put_varint(w, w->tick);
+
+    // Deltas are written behind a placeholder count
+    uint32_t num_deltas = 0;
+    const size_t count_pos = w->buffer_size;
+    put_u8(w, 0);
+    put_u8(w, 0);
+    put_u8(w, 0);
+    const size_t deltas_start = w->buffer_size;
+
+    move_event_ring_t *events = get_move_events(ctx);
+    const uint64_t dropped = w->events.dropped;
+    move_event_t event;
+    while (events && next_move_event(events, &w->events, &event)) {
+        if (event.type == MOVE_EVENT_PROMOTION)
+            continue;
+        // Can't be expressed as a delta
+        if (event.type == MOVE_EVENT_RESET) {
+            w->need_keyframe = true;
+            continue;
+        }
+
+        const uint16_t board = find_board_index(w, event.board);
+        if (board == NO_BOARD) {
+            // Created since the last keyframe
+            w->need_keyframe = true;
+            continue;
+        }
+
+        put_varint(w, board);
+        if (event.type == MOVE_EVENT_GAME_END)
+            put_u16(w, (uint16_t)(event.game_state | DELTA_GAME_STATE << 12));
+        else
+            put_u16(w, (uint16_t)(to_square(event.from) | to_square(event.to) << 6 | DELTA_MOVE << 12));
+        ++num_deltas;
+    }
+    if (w->events.dropped != dropped)
+        w->need_keyframe = true;
+
+    // Fixed three byte varint; a tick never holds more than `MOVE_EVENT_CAPACITY`
+    w->buffer[count_pos + 0] = (uint8_t)((num_deltas & 0x7f) | 0x80);
+    w->buffer[count_pos + 1] = (uint8_t)(((num_deltas >> 7) & 0x7f) | 0x80);
+    w->buffer[count_pos + 2] = (uint8_t)((num_deltas >> 14) & 0x7f);
+    w->stats.delta_bytes += w->buffer_size - deltas_start;
+    w->stats.num_deltas += num_deltas;
+
+    const bool keyframe = w->need_keyframe || w->tick % w->keyframe_interval == 0;
+    put_u8(w, keyframe);
+    if (keyframe) {
+        const size_t keyframe_start = w->buffer_size;
+        put_keyframe(w, ctx);
+        w->stats.keyframe_bytes += w->buffer_size - keyframe_start;
+        ++w->stats.num_keyframes;
+        w->need_keyframe = false;
+    }
+
+    const size_t frame_size = w->buffer_size - MAX_SIZE_PREFIX;
+    uint8_t prefix[MAX_SIZE_PREFIX];
+    size_t prefix_size = 0;
+    for (uint64_t v = frame_size;; v >>= 7) {
+        prefix[prefix_size++] = (uint8_t)((v & 0x7f) | (v >= 0x80 ? 0x80 : 0));
+        if (v < 0x80)
+            break;
+    }
+    uint8_t *frame = w->buffer + MAX_SIZE_PREFIX - prefix_size;
+    memcpy(frame, prefix, prefix_size);
+    write_to_sinks(w, frame, prefix_size + frame_size);
+
+    ++w->tick;
+    ++w->stats.num_ticks;
+    w->stats.num_boards = w->num_boards;
+    return prefix_size + frame_size;
+}
+
+typedef struct reader_t {
+    const uint8_t *p;
+    const uint8_t *end;
+    bool failed;
+} reader_t;
+
+static uint8_t get_u8(reader_t *r)
+{
+    if (r->p >= r->end) {
+        r->failed = true;
+        return 0;
+    }
+    return *r->p++;
+}
+
+static uint64_t get_varint(reader_t *r)
+{
+    uint64_t v = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+        const uint8_t b = get_u8(r);
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+    r->failed = true;
+    return 0;
+}
+
+static void read_keyframe(broadcast_client_t *c, reader_t *r)
+{
+    const uint64_t num_boards = get_varint(r);
+    if (num_boards > BROADCAST_MAX_BOARDS) {
+        r->failed = true;
+        return;
+    }
+
+    if (num_boards > c->capacity) {
+        board_component_t *boards = realloc(c->boards, num_boards * sizeof(board_component_t));
+        if (!boards) {
+            r->failed = true;
+            return;
+        }
+        c->boards = boards;
+        c->capacity = (uint32_t)num_boards;
+    }
+    c->num_boards = (uint32_t)num_boards;
+
+    for (uint32_t b = 0; b < c->num_boards && !r->failed; ++b) {
+        board_component_t *board = &c->boards[b];
+        *board = (board_component_t) {
+            .selected_piece = { .id = UINT64_MAX },
+            .reflection_probe = { .id = UINT64_MAX },
+            .visible = true,
+        };
+        for (int square = 0; square < 64; square += 2) {
+            const uint8_t v = get_u8(r);
+            board->indices[from_square(square)] = v & 0xf;
+            board->indices[from_square(square + 1)] = v >> 4;
+        }
+        const uint8_t flags = get_u8(r);
+        board->current_player = (flags & 1) << 3;
+        board->castle_bits = (flags >> 1) & 0xf;
+        board->en_passant_pos = get_u8(r);
+        board->move_count = (uint32_t)get_varint(r);
+        board->game_state = get_u8(r);
+        board->num_white_captures = get_u8(r);
+        board->num_black_captures = get_u8(r);
+    }
+    c->synced = !r->failed;
+}
+
+static bool read_frame(broadcast_client_t *c, const uint8_t *data, size_t size)
+{
+    reader_t r = { data, data + size, false };
+    c->tick = get_varint(&r);
+
+    const uint64_t num_deltas = get_varint(&r);
+    for (uint64_t d = 0; d < num_deltas && !r.failed; ++d) {
+        const uint64_t board = get_varint(&r);
+        const uint16_t packed = (uint16_t)(get_u8(&r) | get_u8(&r) << 8);
+        if (!c->synced || board >= c->num_boards)
+            continue;
+
+        board_component_t *b = &c->boards[board];
+        if (packed >> 12 == DELTA_GAME_STATE) {
+            b->game_state = (uint8_t)packed;
+            continue;
+        }
+
+        const int from = from_square(packed & 63);
+        const int to = from_square((packed >> 6) & 63);
+        const bool is_white = b->current_player == PIECE_WHITE;
+        const move_info_t info = rules_api->perform_move(b, from, to);
+        if (info.capture) {
+            if (is_white)
+                ++b->num_black_captures;
+            else
+                ++b->num_white_captures;
+        }
+        ++c->num_moves;
+    }
+
+    if (get_u8(&r))
+        read_keyframe(c, &r);
+
+    ++c->num_frames;
+    return !r.failed && r.p == r.end;
+}
+
+bool feed_broadcast_client(broadcast_client_t *c, const void *data, size_t size)
+{
+    if (!reserve_bytes(&c->pending, &c->pending_capacity, c->pending_size + size))
+        return false;
+    memcpy(c->pending + c->pending_size, data, size);
+    c->pending_size += size;
+
+    size_t pos = 0;
+    for (;;) {
+        // Frame size prefix, wait for more if it's cut off
+        reader_t r = { c->pending + pos, c->pending + c->pending_size, false };
+        const uint64_t frame_size = get_varint(&r);
+        if (r.failed || (size_t)(r.end - r.p) < frame_size)
+            break;
+
+        if (!read_frame(c, r.p, (size_t)frame_size))
+            return false;
+        pos = (size_t)(r.p - c->pending) + (size_t)frame_size;
+    }
+
+    memmove(c->pending, c->pending + pos, c->pending_size - pos);
+    c->pending_size -= pos;
+    return true;
+}
+
+void free_broadcast_client(broadcast_client_t *c)
+{
+    free(c->boards);
+    free(c->pending);
+    *c = (broadcast_client_t) { 0 };
+}
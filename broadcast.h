@@ -0,0 +1,90 @@
+#pragma once
+#include "foundation/basic.h"
+#include "components.h"
+#include "move_events.h"
+
+struct entity_ctx_o;
+
+enum {
+    BROADCAST_MAX_SINKS = 16,
+    BROADCAST_MAX_BOARDS = 4096,
+    // Slots of the entity to stream index table, a power of two
+    BROADCAST_BOARD_TABLE_SIZE = BROADCAST_MAX_BOARDS * 2,
+};
+
+// Stream layout, all integers little endian, `varint` is LEB128:
+//
+//   frame:    varint size, varint tick, varint num_deltas, delta[num_deltas],
+//             u8 has_keyframe, keyframe (if has_keyframe)
+//   delta:    varint board, u16 from | to << 6 | kind << 12
+//             kind 0 is a move between squares `x + z * 8`, kind 1 a game
+//             state change with the state in the low byte
+//   keyframe: varint num_boards, board[num_boards]
+//   board:    u8 squares[32] (two pieces per byte, low nibble first),
+//             u8 current_player >> 3 | castle_bits << 1, u8 en_passant_pos,
+//             varint move_count, u8 game_state, u8 num_white_captures,
+//             u8 num_black_captures
+//
+// Boards are numbered by their position in the last keyframe. Moves replay
+// through `perform_move`, so a delta is 3 or 4 bytes.
+
+typedef struct broadcast_stats_t {
+    uint64_t num_ticks;
+    uint64_t num_keyframes;
+    uint64_t num_deltas;
+    uint64_t delta_bytes;
+    uint64_t keyframe_bytes;
+    // Summed over all sinks
+    uint64_t bytes_sent;
+    uint32_t num_boards;
+} broadcast_stats_t;
+
+typedef struct broadcast_writer_t {
+    // Ticks between keyframes, keyframes are also sent for new sinks and boards
+    uint32_t keyframe_interval;
+    int sinks[BROADCAST_MAX_SINKS];
+    uint32_t num_sinks;
+    move_event_cursor_t events;
+    uint64_t tick;
+    bool need_keyframe;
+    // Stream index by entity, open addressing on the entity id
+    uint64_t board_ids[BROADCAST_BOARD_TABLE_SIZE];
+    uint16_t board_indices[BROADCAST_BOARD_TABLE_SIZE];
+    uint32_t num_boards;
+    uint8_t *buffer;
+    size_t buffer_size;
+    size_t buffer_capacity;
+    broadcast_stats_t stats;
+} broadcast_writer_t;
+
+// Boards rebuilt from a stream. Joining mid-stream is fine, deltas are
+// skipped until the first keyframe.
+typedef struct broadcast_client_t {
+    board_component_t *boards;
+    uint32_t num_boards;
+    uint32_t capacity;
+    bool synced;
+    uint64_t tick;
+    // Bytes of a frame that hasn't fully arrived
+    uint8_t *pending;
+    size_t pending_size;
+    size_t pending_capacity;
+    uint64_t num_frames;
+    uint64_t num_moves;
+} broadcast_client_t;
+
+// Heap allocated, the board table alone is 80 KB
+broadcast_writer_t *create_broadcast_writer(struct entity_ctx_o *ctx, uint32_t keyframe_interval);
+void destroy_broadcast_writer(broadcast_writer_t *w);
+
+// `fd` is a file, pipe or socket; it's written with blocking writes and
+// dropped on error. The caller keeps ownership.
+bool add_broadcast_sink(broadcast_writer_t *w, int fd);
+
+// Encodes the moves since the last tick, plus a keyframe when due, and
+// writes the frame to all sinks. Returns the frame size in bytes.
+size_t broadcast_tick(broadcast_writer_t *w, struct entity_ctx_o *ctx);
+
+// Returns false if the stream is corrupt
+bool feed_broadcast_client(broadcast_client_t *c, const void *data, size_t size);
+void free_broadcast_client(broadcast_client_t *c);
@@ -10,305 +10,108 @@
 #include "debug_draw.h"
 #include "entity.h"
 #include "components.h"
+#include "rules.h"
+#include "rules_api.h"
+#include "monotonic_clock.h"
+#include "arena.h"
+#include "move_events.h"
+#include "hierarchy.h"
+#include "frustum.h"
+#include "board_snapshot.h"
+#include "simulation.h"
+#include "latency_histogram.h"
+#include "puzzles.h"
 
 static const float grid_size = 4.315f;
 
-enum {
-    MOVE_TYPE_MOVE,
-    MOVE_TYPE_CAPTURE,
-    MOVE_TYPE_CASTLE,
-};
-
-enum {
-    STATE_PLAYING,
-    STATE_WHITE_WIN_BY_CHECKMATE,
-    STATE_BLACK_WIN_BY_CHECKMATE,
-    STATE_DRAW_BY_STALEMATE,
-};
-
-typedef struct move_info_t {
-    uint8_t move_type;
-    uint8_t capture;
-    int capture_pos;
-    int rook_pos; // Castling
-    uint8_t last_castle_bits;
-    int last_en_passant_pos;
-    uint8_t promotion;
-} move_info_t;
-
-static inline vec3_t grid_to_world_pos(int x, int z, vec3_t offset)
-{
-    float x_pos = (x - 4) * grid_size + grid_size * 0.5f;
-    float z_pos = (z - 4) * grid_size + grid_size * 0.5f;
-    return vec3_add(offset, (vec3_t) { x_pos, 0, z_pos });
-}
-
-static move_info_t perform_move(board_component_t *board, int from, int to)
-{
-    uint8_t capture = board->indices[to];
-
-    move_info_t move_info = {
-        .move_type = capture ? MOVE_TYPE_CAPTURE : MOVE_TYPE_MOVE,
-        .capture = capture,
-        .capture_pos = to,
-        .last_castle_bits = board->castle_bits,
-        .last_en_passant_pos = board->en_passant_pos,
-        .promotion = 0,
-    };
+static const vec4_t black_piece_tint = { 0.08f, 0.08f, 0.08f, 1.f };
 
-    if ((board->indices[from] & MASK_TYPE) == PIECE_KING) {
-        // King was moved; remove castling rights for both sides
-        board->castle_bits &= ~(3 << (board->current_player / 4));
-        // Castling happened; find which side and move the rook
-        if (abs(from - to) == 2) {
-            int rook_from = from + (from > to ? -3 : 4);
-            int rook_to = from + (from > to ? -1 : 1);
-            board->indices[rook_to] = board->indices[rook_from];
-            board->indices[rook_from] = 0;
-            move_info.move_type = MOVE_TYPE_CASTLE;
-            move_info.rook_pos = rook_from;
-        }
-    }
+// Black pieces use the white meshes with `black_piece_tint`. Off until the
+// pieces shader applies the instance tint.
+static bool tint_black_pieces;
 
-    if ((board->indices[from] & MASK_TYPE) == PIECE_ROOK) {
-        // Revoke castling rights for own side
-        if (from == 0x0 || from == 0x70)
-            board->castle_bits &= ~(1 << (board->current_player / 4 + 0));
-        else if (from == 0x7 || from == 0x77)
-            board->castle_bits &= ~(1 << (board->current_player / 4 + 1));
-    }
+// Reduced detail meshes per piece, named "<mesh>_LOD<level>"
+static uint32_t num_piece_lods;
 
-    if ((board->indices[to] & MASK_TYPE) == PIECE_ROOK) {
-        // Revoke castling rights for opponent side
-        uint8_t opponent = board->current_player == PIECE_WHITE ? PIECE_BLACK : PIECE_WHITE;
-        if (to == 0x0 || to == 0x70)
-            board->castle_bits &= ~(1 << (opponent / 4 + 0));
-        else if (to == 0x7 || to == 0x77)
-            board->castle_bits &= ~(1 << (opponent / 4 + 1));
-    }
+// Reflection probe volume of a single board, centered above the board
+static const float board_probe_height = 3.f;
+static const float board_probe_radius = 4.315f * 5.f;
 
-    if ((board->indices[from] & MASK_TYPE) == PIECE_PAWN) {
-        int diff = abs(from - to);
-        if (diff == 32) {
-            // Moved two squares ahead
-            board->en_passant_pos = to;
-        }
-        else if ((diff == 17 || diff == 15) && capture == 0) {
-            // En passant move
-            move_info.move_type = MOVE_TYPE_CAPTURE;
-            int pos = board->en_passant_pos;
-            move_info.capture_pos = pos;
-            move_info.capture = board->indices[pos];
-            board->indices[pos] = 0;
-            board->en_passant_pos = 0;
-        }
-        else {
-            board->en_passant_pos = 0;
-        }
-    } else {
-        board->en_passant_pos = 0;
-    }
-
-    if ((board->indices[from] & MASK_TYPE) == PIECE_PAWN) {
-        int row = to & MASK_ROW;
-        if (row == 0x00 || row == 0x70) {
-            const uint8_t piece_type = PIECE_QUEEN;
-            board->indices[from] = PIECE_QUEEN | (board->indices[from] & MASK_COLOR);
-            move_info.promotion = piece_type;
-        }
-    }
-
-    board->indices[to] = board->indices[from];
-    board->indices[from] = 0;
-
-    board->current_player = board->current_player == PIECE_WHITE ? PIECE_BLACK : PIECE_WHITE;
-    ++board->move_count;
-
-    return move_info;
-}
+// Boards within one cell share a reflection probe, zero gives every board
+// its own. Four boards wide by default.
+static float probe_cell_size = 4.315f * 32.f;
 
-static void revert_move(board_component_t *board, int from, int to, const move_info_t *info)
-{   
-    board->indices[from] = board->indices[to];
-    // Set to zero in case the `capture_pos` was != `to`
-    board->indices[to] = 0;
-    board->indices[info->capture_pos] = info->capture;
+// Thinking time per move. Searches run on the simulation thread between the
+// moves of all other boards, so they are kept short even with a clock.
+static const search_params_t ai_search_params = {
+    .max_depth = 32,
+    .max_time_ms = 150,
+};
 
-    board->castle_bits = info->last_castle_bits;
-    board->en_passant_pos = info->last_en_passant_pos;
-    
-    // Revert castling rook move
-    if (info->move_type == MOVE_TYPE_CASTLE) {
-        int rook_from = from + (from > to ? -3 : 4);
-        int rook_to = from + (from > to ? -1 : 1);
-        board->indices[rook_from] = board->indices[rook_to];
-        board->indices[rook_to] = 0;
-    }
+// Time lost between the search result and the clock being pressed
+static const uint32_t ai_move_overhead_ms = 50;
 
-    // Revert promotion
-    if (info->promotion) {
-        board->indices[from] = PIECE_PAWN | (board->indices[from] & MASK_COLOR);
-    }
+// Without the simulation thread the search blocks the frame, so it gets
+// only a slice of it, a clock can only shorten it
+static const uint32_t ai_frame_search_ms = 4;
 
-    board->current_player = board->current_player == PIECE_WHITE ? PIECE_BLACK : PIECE_WHITE;
-    --board->move_count;
-}
+// Scratch memory for names and UI strings, released every frame
+static arena_t frame_arena;
 
-static bool is_legal_move(board_component_t *board, int from, int to)
+// Position of a square relative to the board entity
+static inline vec3_t grid_to_board_pos(int x, int z)
 {
-    if ((to & 0x88) != 0)
-        return false;
-
-    uint8_t piece_to_move = board->indices[from];
-    if (piece_to_move == 0)
-        return false;
-
-    if ((piece_to_move & MASK_COLOR) != board->current_player)
-        return false;
-
-    uint8_t piece_to_capture = board->indices[to];
-    if (piece_to_capture != 0 && (piece_to_capture & MASK_COLOR) == board->current_player)
-        return false;
-
-    bool can_move = false;
-
-    int diff = abs(from - to);
-    switch (piece_to_move & MASK_TYPE) {
-        case PIECE_PAWN: {
-            int dir = from - to > 0 ? 0 : 8;
-            int row = from & MASK_ROW;
-            if ((piece_to_move & MASK_COLOR) == dir) {
-                can_move |= (diff == 16 && piece_to_capture == 0);
-                can_move |= ((diff == 15 || diff == 17) && piece_to_capture != 0);
-                can_move |= (diff == 32 && (row == 0x60 || row == 0x10) && piece_to_capture == 0 && board->indices[from + (dir != 0 ? 16 : -16)] == 0);
-                if (board->en_passant_pos && piece_to_capture == 0) {
-                    can_move |= (diff == (dir != 0 ? 15 : 17) && (from - 1) == board->en_passant_pos);
-                    can_move |= (diff == (dir != 0 ? 17 : 15) && (from + 1) == board->en_passant_pos);
-                }
-            }
-            break;
-        }
-        case PIECE_KNIGHT: {
-            can_move |= (diff == 14 || diff == 18 || diff == 31 || diff == 33);
-            break;
-        }
-        case PIECE_KING: {
-            int dir = from - to > 0 ? 1 : 0;
-            // Castling move; check castling rights and check if rook move is legal
-            can_move |= (diff == 2 && (board->castle_bits >> (board->current_player / 4 + dir) & 1) != 0 && is_legal_move(board, from + (dir != 0 ? -3 : 4), from + (dir != 0 ? -1 : 1)));
-            can_move |= (diff == 1 || diff == 16 || diff == 17 || diff == 15);
-            break;
-        }
-        case PIECE_BISHOP: {
-            can_move |= (diff % 15 == 0 || diff % 17 == 0);
-            break;
-        }
-        case PIECE_ROOK: {
-            can_move |= ((from & 0x0f) == (to & 0x0f) || (from & 0xf0) == (to & 0xf0));
-            break;
-        }
-        case PIECE_QUEEN: {
-            can_move |= (diff % 15 == 0 || diff % 17 == 0 || (from & 0x0f) == (to & 0x0f) || (from & 0xf0) == (to & 0xf0));
-            break;
-        }
-    }
-
-    if (can_move && (piece_to_move & MASK_SLIDE)) {
-        int dir = to - from;
-        int step = 0;
-        if (dir % 17 == 0) step = 17;
-        else if (dir % 15 == 0) step = 15;
-        else if (dir % 16 == 0) step = 16;
-        else step = 1;
-
-        step = (dir / step < 0) ? -step : step;
-
-        int path = from + step;
-        for (int i = 1; i < (to - from) / step; ++i, path += step) {
-            can_move &= board->indices[path] == 0;
-        }
-    }
-
-    return can_move;
+    float x_pos = (x - 4) * grid_size + grid_size * 0.5f;
+    float z_pos = (z - 4) * grid_size + grid_size * 0.5f;
+    return (vec3_t) { x_pos, 0, z_pos };
 }
 
-static bool is_piece_attacked(board_component_t *board, uint8_t piece)
+static inline transform_t make_local_transform(vec3_t pos)
 {
-    // Find piece position
-    int pos = 0;
-    for (int i = 0; i < 128; ++i) {
-        if (board->indices[i] == piece) {
-            pos = i;
-            break;
-        }
-    }
-
-    // Check if any piece can attack `pos`
-    bool attacked = false;
-    for (int i = 0; i < 128; ++i) {
-        if (is_legal_move(board, i, pos)) {
-            attacked = true;
-            break;
-        }
-    }
-
-    return attacked;
+    return (transform_t) { .pos = pos, .rot = make_vec4(0, 0, 0, 1), .scl = make_vec3(1, 1, 1) };
 }
 
-static bool is_checked_after_move(board_component_t *board, int from, int to)
+// Bit `x + z * 8` is set for every square the piece at `from` can move to
+static uint64_t compute_legal_move_mask(board_component_t *board, int from)
 {
-    move_info_t info = perform_move(board, from, to);
-
-    const uint8_t king_piece = PIECE_KING | (board->current_player == PIECE_WHITE ? PIECE_BLACK : PIECE_WHITE);
-    bool checked = is_piece_attacked(board, king_piece);
-    revert_move(board, from, to, &info);
-
-    return checked;
+    uint64_t mask = 0;
+    for (uint32_t board_idx = 0; board_idx < 64; ++board_idx) {
+        int to = (board_idx % 8) + (board_idx / 8) * 16;
+        if (rules_api->is_legal_move(board, from, to) && !rules_api->is_checked_after_move(board, from, to))
+            mask |= 1ULL << board_idx;
+    }
+    return mask;
 }
 
-static void check_end_condition_reached(board_component_t *board)
+// Legal moves of the piece under the cursor, computed before it's clicked.
+// Valid while the piece stays put and no move is made on its board.
+static struct {
+    entity_t piece;
+    entity_t board;
+    int from;
+    uint32_t move_count;
+    uint64_t legal_mask;
+} hover = { .piece = { .id = UINT64_MAX } };
+
+static inline bool is_hover_cache_valid(const board_component_t *board, entity_t piece_entity, const piece_component_t *piece)
 {
-    // Switch player temporarily to check if king is checked
-    const uint8_t player = board->current_player;
-    board->current_player = player == PIECE_WHITE ? PIECE_BLACK : PIECE_WHITE;
-    bool checked = is_piece_attacked(board, PIECE_KING | player);
-    board->current_player = player;
-
-    int num_legal_moves = 0;
-    for (int from = 0; from < 128; ++from)
-        for (int to = 0; to < 128; ++to)
-            num_legal_moves += (is_legal_move(board, from, to) && !is_checked_after_move(board, from, to));
-
-    if (num_legal_moves == 0) {
-        log_print(LOG_INFO, "No legal moves! Stalemate: %i", !checked);
-    }
-
-    if (num_legal_moves == 0) {
-        if (checked)
-            board->game_state = player == PIECE_WHITE ? STATE_BLACK_WIN_BY_CHECKMATE: STATE_WHITE_WIN_BY_CHECKMATE;
-        else
-            board->game_state = STATE_DRAW_BY_STALEMATE;
-    }
-    else {
-        board->game_state = STATE_PLAYING;
-    }
+    return hover.piece.id == piece_entity.id && hover.board.id == piece->board.id
+        && hover.from == piece->board_position && hover.move_count == board->move_count;
 }
 
-static void update_legal_move_indices_for_piece(board_component_t *board, piece_component_t *piece)
+static void update_legal_move_indices_for_piece(board_component_t *board, entity_t piece_entity, piece_component_t *piece)
 {
-    int from = piece->board_position;
-    for (uint32_t board_idx = 0; board_idx < 64; ++board_idx) {
-        int to = (board_idx % 8) + (board_idx / 8) * 16;
-        board->legal_move_indices[board_idx] = is_legal_move(board, from, to) && !is_checked_after_move(board, from, to);
-    }
+    const uint64_t mask = is_hover_cache_valid(board, piece_entity, piece) ? hover.legal_mask : compute_legal_move_mask(board, piece->board_position);
+    for (uint32_t board_idx = 0; board_idx < 64; ++board_idx)
+        board->legal_move_indices[board_idx] = (mask >> board_idx) & 1;
 }
 
-static entity_t add_piece(entity_t owner, entity_ctx_o *ctx, uint8_t piece_mask, int x, int z, vec3_t offset)
+static entity_t add_piece(entity_t owner, entity_ctx_o *ctx, uint8_t piece_mask, int x, int z)
 {
     entity_t e = make_entity(ctx);
 
-    transform_t *tm = add_component(ctx, e, transform_id);
-    tm->pos = grid_to_world_pos(x, z, offset);
+    const transform_t local = make_local_transform(grid_to_board_pos(x, z));
+    transform_t *tm = &attach_transform(ctx, e, owner, &local)->local;
 
     if ((piece_mask & MASK_TYPE) == PIECE_PAWN || (piece_mask & MASK_TYPE) == PIECE_ROOK) {
         // Set random rotation for pawn and rook
@@ -330,19 +133,19 @@ static entity_t add_piece(entity_t owner, entity_ctx_o *ctx, uint8_t piece_mask,
     char *mesh_name = 0;
     switch (piece_mask & MASK_TYPE) {
         case PIECE_PAWN:
-            mesh_name = temp_print("Pawn_0%i", x + 1);
+            mesh_name = arena_print(&frame_arena, "Pawn_0%i", x + 1);
             break;
         case PIECE_KNIGHT:
-            mesh_name = temp_print("Knight_0%i", x > 4 ? 1 : 2);
+            mesh_name = arena_print(&frame_arena, "Knight_0%i", x > 4 ? 1 : 2);
             break;
         case PIECE_KING:
             mesh_name = "King";
             break;
         case PIECE_BISHOP:
-            mesh_name = temp_print("Bishop_0%i", x > 4 ? 1 : 2);
+            mesh_name = arena_print(&frame_arena, "Bishop_0%i", x > 4 ? 1 : 2);
             break;
         case PIECE_ROOK:
-            mesh_name = temp_print("Rook_0%i", x > 4 ? 1 : 2);
+            mesh_name = arena_print(&frame_arena, "Rook_0%i", x > 4 ? 1 : 2);
             break;
         case PIECE_QUEEN:
             mesh_name = "Queen";
@@ -352,77 +155,199 @@ static entity_t add_piece(entity_t owner, entity_ctx_o *ctx, uint8_t piece_mask,
             break;
     }
 
+    const bool tinted = tint_black_pieces && (piece_mask & MASK_COLOR) == PIECE_BLACK;
+    const char *color_name = (piece_mask & MASK_COLOR) == PIECE_WHITE || tinted ? "White" : "Black";
     mesh_component_t *mesh = add_component(ctx, e, mesh_id);
-    const char *color_name = (piece_mask & MASK_COLOR) == PIECE_WHITE ? "White" : "Black";
-    set_mesh_path(mesh, temp_print("data/models/chess/%s_%s.triangle_mesh", color_name, mesh_name));
+    set_mesh_path(mesh, arena_print(&frame_arena, "data/models/chess/%s_%s.triangle_mesh", color_name, mesh_name));
+    for (uint32_t level = 1; level <= num_piece_lods; ++level)
+        set_lod_mesh_path(mesh, arena_print(&frame_arena, "data/models/chess/%s_%s_LOD%u.triangle_mesh", color_name, mesh_name, level), level);
     set_material_path(mesh, "data/materials/pieces.material", 0);
+    if (tinted)
+        mesh->tint = black_piece_tint;
 
     return e;
 }
 
-static void add_reflection_probe(entity_ctx_o *ctx, vec3_t pos, float r)
+static entity_t add_reflection_probe(entity_ctx_o *ctx, int32_t cell_x, int32_t cell_z)
 {
     entity_t e = make_entity(ctx);
-    transform_t *tm = add_component(ctx, e, transform_id);
-    tm->pos = pos;
+    const transform_t local = make_local_transform(make_vec3(0, 0, 0));
+    attach_transform(ctx, e, NO_PARENT, &local);
 
     light_component_t *light = add_component(ctx, e, light_id);
     light->type = LIGHT_TYPE_IBL;
 
     volume_component_t *volume = add_component(ctx, e, volume_id);
-    volume->bb_min = make_vec3(-r, -r, -r);
-    volume->bb_max = make_vec3(r, r, r);
-    volume->blend_distance = r * 0.3f;
+    volume->blend_distance = board_probe_radius * 0.3f;
 
     mesh_component_t *mesh = add_component(ctx, e, mesh_id);
     set_mesh_path(mesh, "data/models/sphere.triangle_mesh");
     set_material_path(mesh, "data/materials/reflection_probe.material", 0);
     mesh->visibility_mask = VIEWER_MASK_EDITOR;
+
+    probe_component_t *probe = add_component(ctx, e, probe_id);
+    probe->cell_x = cell_x;
+    probe->cell_z = cell_z;
+
+    return e;
+}
+
+// Moves the probe to the centroid of its boards and sizes its volume to cover them
+static void fit_reflection_probe(entity_ctx_o *ctx, entity_t e)
+{
+    const probe_component_t *probe = get_component(ctx, e, probe_id);
+    volume_component_t *volume = get_component(ctx, e, volume_id);
+
+    const vec3_t center = vec3_mul(probe->center_sum, 1.f / (float)probe->num_boards);
+    set_local_position(get_component(ctx, e, hierarchy_id), center);
+    volume->bb_min = vec3_sub(probe->bb_min, center);
+    volume->bb_max = vec3_sub(probe->bb_max, center);
+}
+
+static inline vec3_t board_probe_center(vec3_t board_pos)
+{
+    return vec3_add(board_pos, make_vec3(0, board_probe_height, 0));
+}
+
+static void include_in_probe(probe_component_t *probe, vec3_t board_pos)
+{
+    const vec3_t center = board_probe_center(board_pos);
+    const vec3_t r = { board_probe_radius, board_probe_radius, board_probe_radius };
+    const vec3_t lo = vec3_sub(center, r);
+    const vec3_t hi = vec3_add(center, r);
+
+    if (probe->num_boards == 0) {
+        probe->bb_min = lo;
+        probe->bb_max = hi;
+    }
+    else {
+        probe->bb_min = make_vec3(fminf(probe->bb_min.x, lo.x), fminf(probe->bb_min.y, lo.y), fminf(probe->bb_min.z, lo.z));
+        probe->bb_max = make_vec3(fmaxf(probe->bb_max.x, hi.x), fmaxf(probe->bb_max.y, hi.y), fmaxf(probe->bb_max.z, hi.z));
+    }
+    probe->center_sum = vec3_add(probe->center_sum, center);
+    ++probe->num_boards;
+}
+
+static void assign_reflection_probe(entity_ctx_o *ctx, entity_t board_entity, vec3_t board_pos)
+{
+    const vec3_t center = board_probe_center(board_pos);
+    const bool shared = probe_cell_size > 0.f;
+    const int32_t cell_x = shared ? (int32_t)floorf(center.x / probe_cell_size) : 0;
+    const int32_t cell_z = shared ? (int32_t)floorf(center.z / probe_cell_size) : 0;
+
+    entity_t probe_entity = { .id = UINT64_MAX };
+    if (shared) {
+        const probe_component_t *probes = component_data(ctx, probe_id);
+        entity_t e;
+        uint32_t i = 0;
+        while (find_next_component(ctx, probe_id, (1ULL << probe_id), &i, &e)) {
+            if (probes[i].cell_x == cell_x && probes[i].cell_z == cell_z) {
+                probe_entity = e;
+                break;
+            }
+            ++i;
+        }
+    }
+    if (!is_entity_alive(ctx, probe_entity))
+        probe_entity = add_reflection_probe(ctx, cell_x, cell_z);
+
+    include_in_probe(get_component(ctx, probe_entity, probe_id), board_pos);
+    fit_reflection_probe(ctx, probe_entity);
+
+    board_component_t *board = get_component(ctx, board_entity, board_id);
+    board->reflection_probe = probe_entity;
+}
+
+// Recomputes the probe from its remaining boards, removing it when none are left
+static void refit_reflection_probe(entity_ctx_o *ctx, entity_t probe_entity)
+{
+    probe_component_t *probe = get_component(ctx, probe_entity, probe_id);
+    probe->num_boards = 0;
+    probe->center_sum = make_vec3(0, 0, 0);
+
+    const board_component_t *boards = component_data(ctx, board_id);
+    entity_t e;
+    uint32_t i = 0;
+    while (find_next_component(ctx, board_id, (1ULL << board_id | 1ULL << hierarchy_id), &i, &e)) {
+        if (boards[i].reflection_probe.id == probe_entity.id) {
+            const hierarchy_component_t *h = get_component(ctx, e, hierarchy_id);
+            include_in_probe(probe, h->local.pos);
+        }
+        ++i;
+    }
+
+    if (probe->num_boards == 0)
+        destroy_entity(ctx, probe_entity);
+    else
+        fit_reflection_probe(ctx, probe_entity);
+}
+
+void set_reflection_probe_cell_size(float size)
+{
+    probe_cell_size = size;
+}
+
+void set_black_piece_tint(bool enabled)
+{
+    tint_black_pieces = enabled;
+}
+
+void set_piece_lod_levels(uint32_t num_levels)
+{
+    num_piece_lods = num_levels < MAX_MESH_LODS ? num_levels : MAX_MESH_LODS - 1;
 }
 
-void create_board(entity_ctx_o *ctx, vec3_t offset)
+entity_t create_board(entity_ctx_o *ctx, vec3_t offset)
 {
     entity_t owner = make_entity(ctx);
 
-    // Ground plane
-    transform_t *board_tm = add_component(ctx, owner, transform_id);
-    board_tm->pos = offset;
-    board_tm->rot = quaternion_from_rotation((vec3_t) { 1, 0, 1 }, PI);
-    mesh_component_t *board_mesh = add_component(ctx, owner, mesh_id);
-    set_mesh_path(board_mesh, "data/models/chess/Board.triangle_mesh");
-    set_material_path(board_mesh, "data/materials/board.material", 0);
-    board_mesh->visibility_mask = VIEWER_MASK_MAIN;
+    // Everything on the board is placed relative to the owner, so moving it
+    // only touches one transform
+    const transform_t local = make_local_transform(offset);
+    attach_transform(ctx, owner, NO_PARENT, &local);
 
     board_component_t *board = add_component(ctx, owner, board_id);
-    (void)board;
+    board->snapshot = create_board_snapshot_slot(board);
+
+    // Ground plane; lives on a child so the mesh rotation isn't inherited by the pieces
+    {
+        entity_t e = make_entity(ctx);
+        transform_t local = make_local_transform(make_vec3(0, 0, 0));
+        local.rot = quaternion_from_rotation((vec3_t) { 1, 0, 1 }, PI);
+        attach_transform(ctx, e, owner, &local);
+        mesh_component_t *board_mesh = add_component(ctx, e, mesh_id);
+        set_mesh_path(board_mesh, "data/models/chess/Board.triangle_mesh");
+        set_material_path(board_mesh, "data/materials/board.material", 0);
+        board_mesh->visibility_mask = VIEWER_MASK_MAIN;
+    }
 
     for (int j = 0; j < 2; ++j) {
         uint8_t color = j == 0 ? PIECE_WHITE : PIECE_BLACK;
         uint8_t row = j != 0 ? 0 : 7;
-        add_piece(owner, ctx, PIECE_ROOK | color, 0, row, offset);
-        add_piece(owner, ctx, PIECE_KNIGHT | color, 1, row, offset);
-        add_piece(owner, ctx, PIECE_BISHOP | color, 2, row, offset);
-        add_piece(owner, ctx, PIECE_KING | color, 3, row, offset);
-        add_piece(owner, ctx, PIECE_QUEEN | color, 4, row, offset);
-        add_piece(owner, ctx, PIECE_BISHOP | color, 5, row, offset);
-        add_piece(owner, ctx, PIECE_KNIGHT | color, 6, row, offset);
-        add_piece(owner, ctx, PIECE_ROOK | color, 7, row, offset);
+        add_piece(owner, ctx, PIECE_ROOK | color, 0, row);
+        add_piece(owner, ctx, PIECE_KNIGHT | color, 1, row);
+        add_piece(owner, ctx, PIECE_BISHOP | color, 2, row);
+        add_piece(owner, ctx, PIECE_KING | color, 3, row);
+        add_piece(owner, ctx, PIECE_QUEEN | color, 4, row);
+        add_piece(owner, ctx, PIECE_BISHOP | color, 5, row);
+        add_piece(owner, ctx, PIECE_KNIGHT | color, 6, row);
+        add_piece(owner, ctx, PIECE_ROOK | color, 7, row);
     }
 
     for (int i = 0; i < 8; ++i) {
-        add_piece(owner, ctx, PIECE_PAWN | PIECE_WHITE, i, 6, offset);
-        add_piece(owner, ctx, PIECE_PAWN | PIECE_BLACK, i, 1, offset);
+        add_piece(owner, ctx, PIECE_PAWN | PIECE_WHITE, i, 6);
+        add_piece(owner, ctx, PIECE_PAWN | PIECE_BLACK, i, 1);
     }
 
     // Create grid overlay
     for (int z = 0; z < 8; ++z) {
         for (int x = 0; x < 8; ++x) {
             entity_t e = make_entity(ctx);
-            transform_t *tm = add_component(ctx, e, transform_id);
-            tm->pos = grid_to_world_pos(x, z, offset);
+            transform_t local = make_local_transform(grid_to_board_pos(x, z));
             // Avoid clipping board mesh
-            tm->pos.y += 0.01f;
-            tm->scl = vec3_mul((vec3_t) { 1, 1, 1 }, grid_size * 0.01f * 0.5f);
+            local.pos.y += 0.01f;
+            local.scl = vec3_mul((vec3_t) { 1, 1, 1 }, grid_size * 0.01f * 0.5f);
+            attach_transform(ctx, e, owner, &local);
 
             mesh_component_t *mesh = add_component(ctx, e, mesh_id);
             set_mesh_path(mesh, "data/models/chess/Plane.triangle_mesh");
@@ -436,116 +361,673 @@ void create_board(entity_ctx_o *ctx, vec3_t offset)
         }
     }
 
-    vec3_t probe_offset = make_vec3(offset.x + grid_size * 0.5f, 3.f, offset.z + grid_size * 0.5f);
-    add_reflection_probe(ctx, grid_to_world_pos(3, 3, probe_offset), grid_size * 5.f);
+    assign_reflection_probe(ctx, owner, offset);
+
+    return owner;
+}
+
+// Slots of destroyed boards the simulation queue had no room for
+static struct {
+    board_snapshot_slot_t **slots;
+    uint32_t num_slots;
+    uint32_t capacity;
+} dropped_snapshots;
+
+// Snapshots are destroyed by the thread publishing them, after any move of
+// the board still in flight. Returns false if the queue is full.
+static bool try_destroy_snapshot_slot(board_snapshot_slot_t *slot)
+{
+    if (!is_simulation_thread_running()) {
+        destroy_board_snapshot_slot(slot);
+        return true;
+    }
+
+    sim_command_t command = {
+        .type = SIM_COMMAND_DESTROY_SNAPSHOT,
+        .board_entity = { .id = UINT64_MAX },
+    };
+    command.board.snapshot = slot;
+    return push_sim_command(&command);
+}
+
+static void destroy_snapshot_slot(board_snapshot_slot_t *slot)
+{
+    if (!slot || try_destroy_snapshot_slot(slot))
+        return;
+
+    if (dropped_snapshots.num_slots == dropped_snapshots.capacity) {
+        const uint32_t capacity = dropped_snapshots.capacity ? dropped_snapshots.capacity * 2 : 16;
+        board_snapshot_slot_t **slots = realloc(dropped_snapshots.slots, capacity * sizeof(*slots));
+        if (!slots) {
+            log_print(LOG_ERROR, "Out of memory, board snapshot leaked");
+            return;
+        }
+        dropped_snapshots.slots = slots;
+        dropped_snapshots.capacity = capacity;
+    }
+    dropped_snapshots.slots[dropped_snapshots.num_slots++] = slot;
+}
+
+static void retry_dropped_snapshots(void)
+{
+    while (dropped_snapshots.num_slots > 0 && try_destroy_snapshot_slot(dropped_snapshots.slots[dropped_snapshots.num_slots - 1]))
+        --dropped_snapshots.num_slots;
+}
+
+void destroy_board(entity_ctx_o *ctx, entity_t board_entity)
+{
+    board_component_t *board = get_component(ctx, board_entity, board_id);
+    destroy_snapshot_slot(board->snapshot);
+    board->snapshot = 0;
+    const entity_t probe = board->reflection_probe;
+    board->reflection_probe.id = UINT64_MAX;
+
+    // Pieces, captured ones included, tiles and the ground plane
+    const hierarchy_component_t *hierarchy = component_data(ctx, hierarchy_id);
+    uint32_t num_children = 0;
+    entity_t e;
+    uint32_t i = 0;
+    while (find_next_component(ctx, hierarchy_id, 1ULL << hierarchy_id, &i, &e)) {
+        num_children += hierarchy[i].parent.id == board_entity.id;
+        ++i;
+    }
+    entity_t *children = arena_push_array(&frame_arena, entity_t, num_children);
+    uint32_t n = 0;
+    i = 0;
+    while (n < num_children && find_next_component(ctx, hierarchy_id, 1ULL << hierarchy_id, &i, &e)) {
+        if (hierarchy[i].parent.id == board_entity.id)
+            children[n++] = e;
+        ++i;
+    }
+    for (uint32_t k = 0; k < n; ++k)
+        destroy_entity(ctx, children[k]);
+    destroy_entity(ctx, board_entity);
+
+    if (is_entity_alive(ctx, probe))
+        refit_reflection_probe(ctx, probe);
+    if (hover.board.id == board_entity.id)
+        hover.piece.id = UINT64_MAX;
+}
+
+void release_world(entity_ctx_o *ctx)
+{
+    board_component_t *boards = component_data(ctx, board_id);
+    entity_t e;
+    uint32_t i = 0;
+    while (find_next_component(ctx, board_id, 1ULL << board_id, &i, &e)) {
+        destroy_snapshot_slot(boards[i].snapshot);
+        boards[i].snapshot = 0;
+        ++i;
+    }
+    release_move_events(ctx);
 }
 
-static void move_piece(entity_ctx_o *ctx, entity_t e, int x, int z, vec3_t board_pos)
+static void move_piece(entity_ctx_o *ctx, entity_t e, int x, int z)
 {
     piece_component_t *piece = get_component(ctx, e, piece_id);
-    transform_t *transform = get_component(ctx, e, transform_id);
+    hierarchy_component_t *h = get_component(ctx, e, hierarchy_id);
     piece->move_t = 0.0f;
     piece->want_to_move = true;
-    piece->world_pos_from = transform->pos;
-    piece->world_pos_to = grid_to_world_pos(x, z, board_pos);
+    piece->pos_from = h->local.pos;
+    piece->pos_to = grid_to_board_pos(x, z);
     piece->board_position = x + z * 16;
 }
 
-static void move_piece_offboard(entity_ctx_o *ctx, entity_t e, uint8_t num_captures, vec3_t board_pos)
+static void move_piece_offboard(entity_ctx_o *ctx, entity_t e, uint8_t num_captures)
 {
     piece_component_t *piece = get_component(ctx, e, piece_id);
-    transform_t *transform = get_component(ctx, e, transform_id);
+    hierarchy_component_t *h = get_component(ctx, e, hierarchy_id);
     piece->move_t = 0.0f;
     piece->want_to_move = true;
-    piece->world_pos_from = transform->pos;
+    piece->pos_from = h->local.pos;
 
     const float piece_size = 2.7f;
     const float x_pos = 4.7f * grid_size;
     float x = (piece->mask & MASK_COLOR) == PIECE_WHITE ? x_pos : -x_pos;
     float z = piece_size * ((num_captures + 1) / 2) * (num_captures % 2 ? 1 : -1);
-    piece->world_pos_to = vec3_add(board_pos, make_vec3(x, 0, z));
+    piece->pos_to = make_vec3(x, 0, z);
     piece->board_position = -1;
 }
 
+static entity_t find_piece_at(entity_ctx_o *ctx, entity_t board_entity, int board_position)
+{
+    piece_component_t *pieces = component_data(ctx, piece_id);
+    entity_t e;
+    uint32_t idx = 0;
+    const uint64_t mask = 1 << piece_id | 1 << transform_id;
+    while (find_next_component(ctx, piece_id, mask, &idx, &e)) {
+        if (pieces[idx].board_position == board_position && pieces[idx].board.id == board_entity.id) {
+            return e;
+        }
+        ++idx;
+    }
+    return (entity_t) { .id = UINT64_MAX };
+}
+
+static void push_game_end_event(entity_ctx_o *ctx, entity_t board_entity, const board_component_t *board)
+{
+    move_event_ring_t *events = get_move_events(ctx);
+    if (!events)
+        return;
+
+    const move_event_t event = {
+        .type = MOVE_EVENT_GAME_END,
+        .board = board_entity,
+        .game_state = board->game_state,
+        .move_count = board->move_count,
+    };
+    push_move_event(events, &event);
+}
+
+static void push_move_events(entity_ctx_o *ctx, const move_event_t *event)
+{
+    move_event_ring_t *events = get_move_events(ctx);
+    if (!events)
+        return;
+
+    push_move_event(events, event);
+
+    if (event->promotion) {
+        move_event_t promotion = *event;
+        promotion.type = MOVE_EVENT_PROMOTION;
+        push_move_event(events, &promotion);
+    }
+
+    if (event->type != MOVE_EVENT_GAME_END && event->game_state != STATE_PLAYING) {
+        const move_event_t game_end = {
+            .type = MOVE_EVENT_GAME_END,
+            .board = event->board,
+            .game_state = event->game_state,
+            .move_count = event->move_count,
+        };
+        push_move_event(events, &game_end);
+    }
+}
+
+static inline void publish_board(const board_component_t *board)
+{
+    if (board->snapshot)
+        publish_board_snapshot(board->snapshot, board);
+}
+
+static inline bool is_ai_turn(const board_component_t *board)
+{
+    uint8_t player_bit = board->current_player == PIECE_WHITE ? AI_PLAYER_WHITE : AI_PLAYER_BLACK;
+    return (board->ai_players & player_bit) != 0;
+}
+
+// Moves the pieces of a move already applied to the rules state
+static void apply_move_event(entity_ctx_o *ctx, const move_event_t *event)
+{
+    const entity_t board_entity = event->board;
+    board_component_t *board = get_component(ctx, board_entity, board_id);
+
+    push_move_events(ctx, event);
+    if (event->type == MOVE_EVENT_GAME_END)
+        return;
+
+    const int from = event->from;
+    const int x = event->to % 16;
+    const int z = event->to / 16;
+    entity_t selected = find_piece_at(ctx, board_entity, from);
+    if (!is_entity_alive(ctx, selected))
+        return;
+
+    if (event->promotion) {
+        destroy_entity(ctx, selected);
+        selected = add_piece(board_entity, ctx, event->promotion | (event->piece & MASK_COLOR), from % 16, from / 16);
+        run_load_callback_for_entity(ctx, selected);
+    }
+
+    // Check if we need to move another piece as part of this move
+    // This can be either a capture, castling or en passant
+    if (event->type == MOVE_EVENT_CASTLE) {
+        entity_t e = find_piece_at(ctx, board_entity, event->rook_pos);
+        move_piece(ctx, e, x + (from > event->to ? 1 : -1), z);
+    }
+    else if (event->type == MOVE_EVENT_CAPTURE || event->type == MOVE_EVENT_EN_PASSANT) {
+        entity_t e = find_piece_at(ctx, board_entity, event->capture_pos);
+        bool is_white = (event->piece & MASK_COLOR) == PIECE_WHITE;
+        move_piece_offboard(ctx, e, is_white ? board->num_black_captures : board->num_white_captures);
+
+        if (is_white)
+            ++board->num_black_captures;
+        else
+            ++board->num_white_captures;
+    }
+
+    // Move piece
+    move_piece(ctx, selected, x, z);
+
+    board->selected_piece.id = UINT64_MAX;
+    memset(board->legal_move_indices, 0, 64);
+}
+
+static struct {
+    premove_stats_t stats;
+} premoves;
+
+// Input responsiveness of this session, see `log_input_latency`
+static struct {
+    // Press until the legal move highlight is shown
+    latency_histogram_t select;
+    // Press until the piece starts moving
+    latency_histogram_t move;
+    bool show_overlay;
+} input_latency;
+
+static void apply_sim_moves(entity_ctx_o *ctx, const sim_moves_t *moves)
+{
+    for (uint32_t i = 0; i < moves->num_events; ++i)
+        apply_move_event(ctx, &moves->events[i]);
+
+    if (!moves->premove_tried)
+        return;
+
+    premove_stats_t *stats = &premoves.stats;
+    if (moves->premove_applied) {
+        // Until the premoved piece starts moving
+        const uint64_t latency = time_now_ns() - moves->opponent_move_ns;
+        ++stats->num_applied;
+        stats->total_latency_ns += latency;
+        if (latency > stats->max_latency_ns)
+            stats->max_latency_ns = latency;
+        log_print(LOG_INFO, "Premove applied %.3f ms after the opponent's move", time_ns_to_ms(latency));
+    }
+    else {
+        ++stats->num_rejected;
+        log_print(LOG_INFO, "Premove was illegal in the new position");
+    }
+}
+
+premove_stats_t get_premove_stats(void)
+{
+    return premoves.stats;
+}
+
+// Refuses moves that aren't the next solution move. The last move may be
+// any mate, puzzles often have more than one.
+static bool accept_puzzle_move(puzzle_component_t *puzzle, board_component_t *board, int from, int to)
+{
+    if (puzzle->state != PUZZLE_SOLVING || puzzle->next_move >= puzzle->num_moves)
+        return true;
+
+    const uint32_t n = puzzle->next_move;
+    if (from == puzzle->from[n] && to == puzzle->to[n])
+        return true;
+    // Illegal moves are refused by the rules, and the opponent only plays the solution
+    if (board->current_player != puzzle->player || !rules_api->is_legal_move(board, from, to) || rules_api->is_checked_after_move(board, from, to))
+        return false;
+
+    if (n + 1 == puzzle->num_moves) {
+        board_component_t after = *board;
+        move_t moves[MAX_MOVES];
+        rules_api->perform_move(&after, from, to);
+        rules_api->check_end_condition_with_moves(&after, 0, moves);
+        if (after.game_state == STATE_WHITE_WIN_BY_CHECKMATE || after.game_state == STATE_BLACK_WIN_BY_CHECKMATE)
+            return true;
+    }
+
+    ++puzzle->num_mistakes;
+    log_print(LOG_INFO, "Not the solution of puzzle %u, %u mistakes", puzzle->index, puzzle->num_mistakes);
+    return false;
+}
+
+static void advance_puzzle(entity_ctx_o *ctx, entity_t board_entity)
+{
+    puzzle_component_t *puzzle = get_component(ctx, board_entity, puzzle_id);
+    if (puzzle->state != PUZZLE_SOLVING)
+        return;
+    if (++puzzle->next_move == puzzle->num_moves) {
+        puzzle->state = PUZZLE_SOLVED;
+        log_print(LOG_INFO, "Puzzle %u rated %u solved with %u mistakes", puzzle->index, puzzle->rating, puzzle->num_mistakes);
+    }
+}
+
 static void try_move_selected_piece(entity_ctx_o *ctx, entity_t board_entity, int x, int z)
 {
     board_component_t *board = get_component(ctx, board_entity, board_id);
-    transform_t *board_transform = get_component(ctx, board_entity, transform_id);
     entity_t selected = board->selected_piece;
 
-    if (!is_entity_alive(ctx, selected))
+    if (board->move_pending || !is_entity_alive(ctx, selected))
         return;
 
     piece_component_t *piece = get_component(ctx, selected, piece_id);
     int from = piece->board_position;
     int to = x + z * 16;
 
-    if (!(is_legal_move(board, from, to) && !is_checked_after_move(board, from, to)))
+    const bool is_puzzle = has_component(ctx, board_entity, puzzle_id);
+    if (is_puzzle && !accept_puzzle_move(get_component(ctx, board_entity, puzzle_id), board, from, to))
+        return;
+
+    clock_component_t *clock = has_component(ctx, board_entity, clock_id) ? get_component(ctx, board_entity, clock_id) : 0;
+    const uint64_t now = time_now_ns();
+
+    // The rules run on the simulation thread, the pieces move once the result is back
+    if (is_simulation_thread_running()) {
+        sim_command_t command = {
+            .type = SIM_COMMAND_MOVE,
+            .from = (uint8_t)from,
+            .to = (uint8_t)to,
+            .has_clock = clock != 0,
+            .board_entity = board_entity,
+            .time_ns = now,
+            .board = *board,
+        };
+        if (clock)
+            command.clock = *clock;
+        // Puzzles advance once the move is back, see `update_simulation`
+        if (push_sim_command(&command))
+            board->move_pending = true;
+        else
+            log_print(LOG_WARN, "Simulation queue full, move dropped");
         return;
+    }
 
-    move_info_t info = perform_move(board, from, to);
-    check_end_condition_reached(board);
+    sim_moves_t moves;
+    if (!simulate_move(board_entity, board, clock, from, to, now, &moves))
+        return;
+    apply_sim_moves(ctx, &moves);
+    publish_board(board);
+    if (is_puzzle)
+        advance_puzzle(ctx, board_entity);
+}
 
-    if (info.promotion) {
-        destroy_entity(ctx, selected);
-        selected = add_piece(board_entity, ctx, info.promotion | (piece->mask & MASK_COLOR), from % 16, from / 16, board_transform->pos);
-        run_load_callback_for_entity(ctx, selected);
+// Plays a premove the simulation thread didn't see in time
+static void try_premove(entity_ctx_o *ctx, entity_t board_entity)
+{
+    board_component_t *board = get_component(ctx, board_entity, board_id);
+    if (!board->has_premove || board->move_pending || board->game_state != STATE_PLAYING || board->premove_player != board->current_player)
+        return;
+
+    board->has_premove = false;
+    board->selected_piece = find_piece_at(ctx, board_entity, board->premove_from);
+    try_move_selected_piece(ctx, board_entity, board->premove_to % 16, board->premove_to / 16);
+}
+
+// Takes the rules state computed by the simulation thread, the rest of the
+// board component belongs to the main thread
+static void copy_rules_state(board_component_t *board, const board_component_t *from)
+{
+    memcpy(board->indices, from->indices, sizeof(board->indices));
+    board->current_player = from->current_player;
+    board->castle_bits = from->castle_bits;
+    board->en_passant_pos = from->en_passant_pos;
+    board->move_count = from->move_count;
+    board->game_state = from->game_state;
+}
+
+static void log_ai_search(const search_result_t *result)
+{
+    const search_stats_t *stats = &result->stats;
+    const double probes = stats->tt_probes ? (double)stats->tt_probes : 1.0;
+    log_print(LOG_INFO, "AI searched depth %u, %llu nodes in %.1f ms, branching factor %.2f, score %i, hash hits %.1f%% (%.1f%% cross-process)",
+        stats->depth, (unsigned long long)stats->nodes, time_ns_to_ms(stats->elapsed_ns),
+        rules_api->effective_branching_factor(stats), result->score,
+        100.0 * stats->tt_hits / probes, 100.0 * stats->tt_foreign_hits / probes);
+}
+
+void update_simulation(entity_ctx_o *ctx)
+{
+    retry_dropped_snapshots();
+
+    sim_result_t result;
+    while (pop_sim_result(&result)) {
+        const entity_t board_entity = result.board_entity;
+        if (!is_entity_alive(ctx, board_entity))
+            continue;
+
+        board_component_t *board = get_component(ctx, board_entity, board_id);
+        board->move_pending = false;
+        if (result.search.has_move)
+            log_ai_search(&result.search);
+        if (result.moves.num_events == 0)
+            continue;
+
+        copy_rules_state(board, &result.board);
+        if (result.has_clock && has_component(ctx, board_entity, clock_id))
+            *(clock_component_t *)get_component(ctx, board_entity, clock_id) = result.clock;
+
+        // Consumed by the simulation thread, unless it was changed since
+        if (result.moves.premove_tried && board->premove_player == result.board.premove_player
+            && board->premove_from == result.board.premove_from && board->premove_to == result.board.premove_to)
+            board->has_premove = false;
+
+        apply_sim_moves(ctx, &result.moves);
+        if (result.moves.events[0].type != MOVE_EVENT_GAME_END && has_component(ctx, board_entity, puzzle_id))
+            advance_puzzle(ctx, board_entity);
+        try_premove(ctx, board_entity);
     }
+}
 
-    // Check if we need to move another piece as part of this move
-    // This can be either a capture, castling or en passant
-    if (info.move_type != MOVE_TYPE_MOVE) {
-        int piece_pos = info.move_type == MOVE_TYPE_CAPTURE ? info.capture_pos : info.rook_pos;
+bool set_board_state(entity_ctx_o *ctx, entity_t board_entity, const board_component_t *state)
+{
+    board_component_t *board = get_component(ctx, board_entity, board_id);
+    if (board->move_pending)
+        return false;
 
-        piece_component_t *pieces = component_data(ctx, piece_id);
-        entity_t e;
-        uint32_t idx = 0;
-        const uint64_t mask = 1 << piece_id | 1 << transform_id;
-        while (find_next_component(ctx, piece_id, mask, &idx, &e)) {
-            if (pieces[idx].board_position == piece_pos && pieces[idx].board.id == board_entity.id) {
-                break;
+    // The simulation thread is the only one publishing while it runs. The
+    // board waits for the command like for a move.
+    const bool threaded = is_simulation_thread_running();
+    if (threaded) {
+        sim_command_t command = {
+            .type = SIM_COMMAND_PUBLISH,
+            .board_entity = board_entity,
+            .board = *board,
+        };
+        copy_rules_state(&command.board, state);
+        command.board.has_premove = false;
+        if (!push_sim_command(&command)) {
+            log_print(LOG_WARN, "Simulation queue full, board not replaced");
+            return false;
+        }
+    }
+
+    // Captured pieces go as well; a board never has more than 32
+    entity_t pieces[64];
+    uint32_t num_pieces = 0;
+    const piece_component_t *piece_data = component_data(ctx, piece_id);
+    entity_t e;
+    uint32_t idx = 0;
+    while (num_pieces < 64 && find_next_component(ctx, piece_id, 1ULL << piece_id, &idx, &e)) {
+        if (piece_data[idx].board.id == board_entity.id)
+            pieces[num_pieces++] = e;
+        ++idx;
+    }
+    for (uint32_t i = 0; i < num_pieces; ++i)
+        destroy_entity(ctx, pieces[i]);
+
+    for (int z = 0; z < 8; ++z) {
+        for (int x = 0; x < 8; ++x) {
+            const uint8_t piece_mask = state->indices[x + z * 16];
+            if (piece_mask) {
+                e = add_piece(board_entity, ctx, piece_mask, x, z);
+                run_load_callback_for_entity(ctx, e);
             }
-            ++idx;
         }
+    }
 
-        if (info.move_type == MOVE_TYPE_CASTLE)
-            move_piece(ctx, e, x + (from > to ? 1 : -1), z, board_transform->pos);
-        else if (info.move_type == MOVE_TYPE_CAPTURE) {
-            bool is_white = (piece->mask & MASK_COLOR) == PIECE_WHITE;
-            move_piece_offboard(ctx, e, is_white ? board->num_black_captures : board->num_white_captures, board_transform->pos);
+    // Adding components may have moved the board data
+    board = get_component(ctx, board_entity, board_id);
+    copy_rules_state(board, state);
+    board->num_white_captures = 0;
+    board->num_black_captures = 0;
+    board->selected_piece.id = UINT64_MAX;
+    memset(board->legal_move_indices, 0, 64);
+    board->has_premove = false;
+    board->select_press_ns = 0;
+    board->move_press_ns = 0;
+    if (hover.board.id == board_entity.id)
+        hover.piece.id = UINT64_MAX;
+    if (threaded)
+        board->move_pending = true;
+    else
+        publish_board(board);
+
+    move_event_ring_t *events = get_move_events(ctx);
+    if (events) {
+        const move_event_t event = {
+            .type = MOVE_EVENT_RESET,
+            .board = board_entity,
+            .game_state = board->game_state,
+            .move_count = board->move_count,
+        };
+        push_move_event(events, &event);
+    }
+    return true;
+}
 
-            if (is_white)
-                ++board->num_black_captures;
-            else
-                ++board->num_white_captures;
+bool load_puzzle(entity_ctx_o *ctx, entity_t board_entity, const puzzle_t *puzzle)
+{
+    if (puzzle->num_moves < 2 || puzzle->num_moves > PUZZLE_MAX_MOVES || !set_board_state(ctx, board_entity, &puzzle->board))
+        return false;
+
+    if (!has_component(ctx, board_entity, puzzle_id))
+        add_component(ctx, board_entity, puzzle_id);
+    puzzle_component_t *p = get_component(ctx, board_entity, puzzle_id);
+    *p = (puzzle_component_t) {
+        .index = puzzle->index,
+        .rating = puzzle->rating,
+        .player = opponent_of(puzzle->board.current_player),
+        .state = PUZZLE_SOLVING,
+        .num_moves = (uint8_t)puzzle->num_moves,
+    };
+    for (uint32_t i = 0; i < puzzle->num_moves; ++i) {
+        p->from[i] = puzzle->moves[i].from;
+        p->to[i] = puzzle->moves[i].to;
+    }
+
+    // The solution plays the opponent, and puzzles aren't timed
+    board_component_t *board = get_component(ctx, board_entity, board_id);
+    board->ai_players = 0;
+    if (has_component(ctx, board_entity, clock_id)) {
+        clock_component_t *clock = get_component(ctx, board_entity, clock_id);
+        clock->running = false;
+    }
+
+    log_print(LOG_INFO, "Puzzle %u rated %u, %u moves", puzzle->index, puzzle->rating, puzzle->num_moves / 2);
+    return true;
+}
+
+void update_puzzles(entity_ctx_o *ctx)
+{
+    puzzle_component_t *puzzles = component_data(ctx, puzzle_id);
+    const uint64_t mask = (1ULL << puzzle_id) | (1ULL << board_id);
+
+    entity_t e;
+    uint32_t i = 0;
+    while (find_next_component(ctx, puzzle_id, mask, &i, &e)) {
+        const puzzle_component_t *puzzle = &puzzles[i];
+        board_component_t *board = get_component(ctx, e, board_id);
+        if (puzzle->state == PUZZLE_SOLVING && board->current_player != puzzle->player
+            && board->game_state == STATE_PLAYING && !board->move_pending) {
+            const int to = puzzle->to[puzzle->next_move];
+            board->selected_piece = find_piece_at(ctx, e, puzzle->from[puzzle->next_move]);
+            try_move_selected_piece(ctx, e, to % 16, to / 16);
+            // Adding components may have moved the puzzle data
+            puzzles = component_data(ctx, puzzle_id);
         }
+        ++i;
     }
+}
 
-    // Move piece
-    move_piece(ctx, selected, x, z, board_transform->pos);
+void on_entity_hovered(entity_ctx_o *ctx, entity_t e)
+{
+    if (!is_entity_alive(ctx, e) || !has_component(ctx, e, piece_id))
+        return;
+
+    piece_component_t *piece = get_component(ctx, e, piece_id);
+    if (!is_entity_alive(ctx, piece->board))
+        return;
+
+    board_component_t *board = get_component(ctx, piece->board, board_id);
+    // Only pieces that can be selected right now
+    if (is_ai_turn(board) || board->move_pending || (piece->mask & MASK_COLOR) != board->current_player)
+        return;
+    if (is_hover_cache_valid(board, e, piece))
+        return;
+
+    hover.piece = e;
+    hover.board = piece->board;
+    hover.from = piece->board_position;
+    hover.move_count = board->move_count;
+    hover.legal_mask = compute_legal_move_mask(board, piece->board_position);
+}
+
+// While waiting for the opponent, moves are entered as a premove. Not on
+// puzzle boards, the opponent's reply is part of the solution.
+static void press_during_opponent_turn(entity_ctx_o *ctx, entity_t board_entity, board_component_t *board, entity_t e)
+{
+    if (has_component(ctx, board_entity, puzzle_id))
+        return;
+
+    const uint8_t player = is_ai_turn(board) ? opponent_of(board->current_player) : board->current_player;
+    const uint8_t player_bit = player == PIECE_WHITE ? AI_PLAYER_WHITE : AI_PLAYER_BLACK;
+    if (board->ai_players & player_bit)
+        return;
 
+    int to;
+    if (has_component(ctx, e, piece_id)) {
+        piece_component_t *piece = get_component(ctx, e, piece_id);
+        if ((piece->mask & MASK_COLOR) == player) {
+            board->selected_piece = e;
+            memset(board->legal_move_indices, 0, 64);
+            return;
+        }
+        to = piece->board_position;
+    }
+    else {
+        tile_component_t *tile = get_component(ctx, e, tile_id);
+        to = tile->x + tile->z * 16;
+    }
+
+    if (!is_entity_alive(ctx, board->selected_piece))
+        return;
+
+    const piece_component_t *selected = get_component(ctx, board->selected_piece, piece_id);
+    board->has_premove = true;
+    board->premove_player = player;
+    board->premove_from = (uint8_t)selected->board_position;
+    board->premove_to = (uint8_t)to;
     board->selected_piece.id = UINT64_MAX;
-    memset(board->legal_move_indices, 0, 64);
+}
+
+// Times the move until its animation starts, unless it was rejected
+static void press_move(entity_ctx_o *ctx, entity_t board_entity, int x, int z, uint64_t press_ns)
+{
+    board_component_t *board = get_component(ctx, board_entity, board_id);
+    const uint32_t move_count = board->move_count;
+    try_move_selected_piece(ctx, board_entity, x, z);
+
+    board = get_component(ctx, board_entity, board_id);
+    if (board->move_pending || board->move_count != move_count)
+        board->move_press_ns = press_ns;
 }
 
 void on_entity_pressed(entity_ctx_o *ctx, entity_t e)
 {   
+    const uint64_t press_ns = time_now_ns();
     if (has_component(ctx, e, piece_id)) {
         // Find board that this piece is on
         piece_component_t *piece = get_component(ctx, e, piece_id);
         if (is_entity_alive(ctx, piece->board)) {
             board_component_t *board = get_component(ctx, piece->board, board_id);
+            if (is_ai_turn(board) || board->move_pending) {
+                press_during_opponent_turn(ctx, piece->board, board, e);
+                return;
+            }
             bool is_opponent = (piece->mask & MASK_COLOR) != board->current_player;
             // Wants to capture opponent piece
             if (is_opponent && board->selected_piece.id != UINT64_MAX) {
                 int x = piece->board_position % 16;
                 int z = piece->board_position / 16;
-                try_move_selected_piece(ctx, piece->board, x, z);
+                press_move(ctx, piece->board, x, z, press_ns);
             }
             // Change selection
             else if (!is_opponent) {
                 board->selected_piece = e;
-                update_legal_move_indices_for_piece(board, piece);
+                update_legal_move_indices_for_piece(board, e, piece);
+                board->select_press_ns = press_ns;
             }
         }
     }
@@ -554,15 +1036,24 @@ void on_entity_pressed(entity_ctx_o *ctx, entity_t e)
         // Find the board and try to move the selected piece, if any
         tile_component_t *tile = get_component(ctx, e, tile_id);
         if (is_entity_alive(ctx, tile->board)) {
-            try_move_selected_piece(ctx, tile->board, tile->x, tile->z);
+            board_component_t *board = get_component(ctx, tile->board, board_id);
+            if (is_ai_turn(board) || board->move_pending)
+                press_during_opponent_turn(ctx, tile->board, board, e);
+            else
+                press_move(ctx, tile->board, tile->x, tile->z, press_ns);
         }
     }
 }
 
+void reset_frame_scratch(void)
+{
+    arena_reset(&frame_arena);
+}
+
 void update_pieces(entity_ctx_o *ctx, float dt)
 {
     piece_component_t *pieces = component_data(ctx, piece_id);
-    const uint64_t mask = (1 << piece_id | 1 << transform_id);
+    const uint64_t mask = (1ULL << piece_id | 1ULL << hierarchy_id);
 
     entity_t e;
     uint32_t i = 0;
@@ -572,11 +1063,26 @@ void update_pieces(entity_ctx_o *ctx, float dt)
             p->want_to_move = false;
         } 
         else if (p->want_to_move) {
-            transform_t *tm = get_component(ctx, e, transform_id);
-            tm->pos = vec3_lerp(p->world_pos_from, p->world_pos_to, p->move_t);
+            hierarchy_component_t *h = get_component(ctx, e, hierarchy_id);
+            board_component_t *board = get_component(ctx, p->board, board_id);
+            if (board->move_press_ns && p->move_t == 0.0f) {
+                record_latency(&input_latency.move, time_now_ns() - board->move_press_ns);
+                board->move_press_ns = 0;
+            }
+            if (!board->visible) {
+                // Nobody sees the animation; jump to where it ends
+                set_local_position(h, p->pos_to);
+                p->move_t = 1.0f;
+                p->want_to_move = false;
+                ++i;
+                continue;
+            }
+
+            vec3_t pos = vec3_lerp(p->pos_from, p->pos_to, p->move_t);
 
             const float height = 0.6f;
-            tm->pos.y += sinf(p->move_t * PI) * height;
+            pos.y += sinf(p->move_t * PI) * height;
+            set_local_position(h, pos);
             p->move_t += dt;
         }
         ++i;
@@ -588,13 +1094,31 @@ void update_tiles(entity_ctx_o *ctx, float dt)
     tile_component_t *tiles = component_data(ctx, tile_id);
     const uint64_t mask = (1 << tile_id | 1 << mesh_id);
 
+    // Tiles of a board are created together, so the board lookup is cached
+    entity_t board_entity = { .id = UINT64_MAX };
+    board_component_t *board = 0;
+    const uint64_t now = time_now_ns();
+
     entity_t e;
     uint32_t i = 0;
     while (find_next_component(ctx, tile_id, mask, &i, &e)) {
         tile_component_t tile = tiles[i];
 
+        if (tile.board.id != board_entity.id) {
+            board_entity = tile.board;
+            board = get_component(ctx, board_entity, board_id);
+        }
+        if (!board->visible) {
+            ++i;
+            continue;
+        }
+        // The highlight of a new selection goes out with this frame
+        if (board->select_press_ns) {
+            record_latency(&input_latency.select, now - board->select_press_ns);
+            board->select_press_ns = 0;
+        }
+
         mesh_component_t *mesh = get_component(ctx, e, mesh_id);
-        board_component_t *board = get_component(ctx, tile.board, board_id);
         
         const int idx = tile.x + tile.z * 8;
         mesh->visibility_mask = (board->legal_move_indices[idx] ? VIEWER_MASK_MAIN : 0);
@@ -603,35 +1127,404 @@ void update_tiles(entity_ctx_o *ctx, float dt)
     }
 }
 
-void draw_board_ui(struct entity_ctx_o *ctx)
+uint32_t cull_boards(entity_ctx_o *ctx, const frustum_t *frustum)
 {
+    // Covers the board, pieces lifted while moving and captured pieces beside it
+    const vec3_t half_extent = { 4.7f * grid_size + 2.f, 8.f, 4.f * grid_size + 4.f };
+
     board_component_t *boards = component_data(ctx, board_id);
+    const uint64_t mask = (1ULL << board_id | 1ULL << transform_id);
+    uint32_t num_visible = 0;
 
-    extern struct font_t *font_default;
+    entity_t e;
+    uint32_t i = 0;
+    while (find_next_component(ctx, board_id, mask, &i, &e)) {
+        const transform_t *tm = get_component(ctx, e, transform_id);
+        const vec3_t bb_min = vec3_sub(tm->pos, make_vec3(half_extent.x, 1.f, half_extent.z));
+        const vec3_t bb_max = vec3_add(tm->pos, half_extent);
+        boards[i].visible = frustum_overlaps_box(frustum, bb_min, bb_max);
+        num_visible += boards[i].visible;
+        ++i;
+    }
+    return num_visible;
+}
+
+void set_board_position(entity_ctx_o *ctx, entity_t board_entity, vec3_t pos)
+{
+    set_local_position(get_component(ctx, board_entity, hierarchy_id), pos);
+
+    // The board may have left the cell of its probe
+    board_component_t *board = get_component(ctx, board_entity, board_id);
+    const entity_t old_probe = board->reflection_probe;
+    board->reflection_probe.id = UINT64_MAX;
+    if (is_entity_alive(ctx, old_probe))
+        refit_reflection_probe(ctx, old_probe);
+    assign_reflection_probe(ctx, board_entity, pos);
+}
+
+void add_board_clock(entity_ctx_o *ctx, entity_t board_entity, uint32_t base_ms, uint32_t increment_ms)
+{
+    board_component_t *board = get_component(ctx, board_entity, board_id);
+    clock_component_t *clock = add_component(ctx, board_entity, clock_id);
+    clock->remaining_ns[0] = (int64_t)base_ms * 1000000;
+    clock->remaining_ns[1] = (int64_t)base_ms * 1000000;
+    clock->increment_ns = (uint64_t)increment_ms * 1000000;
+    clock->running_player = board->current_player;
+    clock->turn_start_ns = time_now_ns();
+    clock->running = board->game_state == STATE_PLAYING;
+}
+
+void update_clocks(entity_ctx_o *ctx)
+{
+    clock_component_t *clocks = component_data(ctx, clock_id);
+    const uint64_t mask = (1ULL << clock_id | 1ULL << board_id);
+    const uint64_t now = time_now_ns();
+
+    entity_t e;
+    uint32_t i = 0;
+    while (find_next_component(ctx, clock_id, mask, &i, &e)) {
+        clock_component_t *clock = &clocks[i];
+        if (clock->running && (int64_t)(now - clock->turn_start_ns) >= clock->remaining_ns[clock->running_player / 8]) {
+            board_component_t *board = get_component(ctx, e, board_id);
+            // A pending move checks the flag itself
+            if (board->move_pending) {
+                ++i;
+                continue;
+            }
+
+            if (is_simulation_thread_running()) {
+                sim_command_t command = {
+                    .type = SIM_COMMAND_FLAG,
+                    .has_clock = true,
+                    .board_entity = e,
+                    .time_ns = now,
+                    .clock = *clock,
+                    .board = *board,
+                };
+                command.clock.flagged = true;
+                command.clock.running = false;
+                if (push_sim_command(&command)) {
+                    *clock = command.clock;
+                    board->move_pending = true;
+                }
+                ++i;
+                continue;
+            }
+
+            clock->flagged = true;
+            clock->running = false;
+            rules_api->check_end_condition_reached(board, clock);
+            publish_board(board);
+            push_game_end_event(ctx, e, board);
+        }
+        ++i;
+    }
+}
+
+static search_params_t ai_params(entity_ctx_o *ctx, entity_t board_entity)
+{
+    search_params_t params = ai_search_params;
+    if (has_component(ctx, board_entity, clock_id))
+        params.time.move_overhead_ms = ai_move_overhead_ms;
+    return params;
+}
 
+// Boards searched on the main thread take turns, this is the component
+// index after the last one
+static uint32_t ai_next_board;
+
+// Searches on this thread and plays the move right away
+static void play_ai_move_now(entity_ctx_o *ctx, entity_t board_entity)
+{
+    board_component_t *board = get_component(ctx, board_entity, board_id);
+    clock_component_t *clock = has_component(ctx, board_entity, clock_id) ? get_component(ctx, board_entity, clock_id) : 0;
+    search_params_t params = ai_params(ctx, board_entity);
+    params.max_time_ms = ai_frame_search_ms;
+
+    search_result_t result;
+    sim_moves_t moves;
+    if (simulate_search(board_entity, board, clock, &params, &result, &moves)) {
+        log_ai_search(&result);
+        apply_sim_moves(ctx, &moves);
+        // Adding components may have moved the board data
+        publish_board(get_component(ctx, board_entity, board_id));
+    }
+}
+
+void update_ai(entity_ctx_o *ctx)
+{
+    board_component_t *boards = component_data(ctx, board_id);
     const uint64_t mask = (1ULL << board_id);
+    const bool threaded = is_simulation_thread_running();
+
+    // Without the simulation thread only one board searches per frame
+    entity_t waiting = { .id = UINT64_MAX };
+    uint32_t waiting_index = 0;
+
     entity_t e;
     uint32_t i = 0;
     while (find_next_component(ctx, board_id, mask, &i, &e)) {
         board_component_t *board = &boards[i];
+        if (board->game_state != STATE_PLAYING || !is_ai_turn(board) || board->move_pending) {
+            ++i;
+            continue;
+        }
 
-        if (board->game_state != STATE_PLAYING) {
-            const vec4_t color = (vec4_t) { 1, 1, 1, 1 };
-            const char *reason = (board->game_state == STATE_DRAW_BY_STALEMATE) ? "STALEMATE" : "CHECKMATE";
-            const char *winner = (board->game_state == STATE_DRAW_BY_STALEMATE) ? "Draw." : 
-                (board->game_state == STATE_WHITE_WIN_BY_CHECKMATE ? "White wins." : "Black wins."); 
+        if (!threaded) {
+            if (waiting.id == UINT64_MAX || (waiting_index < ai_next_board && i >= ai_next_board)) {
+                waiting = e;
+                waiting_index = i;
+            }
+            ++i;
+            continue;
+        }
 
-            const rect_t window_r = window_api->rect();
-            rect_t r = rect_inset((rect_t) { 0, window_r.h * 0.5f, window_r.w, 0 }, 0, -90.f);
-            rect_t top = rect_divide_y(r, 0.f, 2, 0);
-            rect_t bot = rect_divide_y(r, 0.f, 2, 1);
-            
-            im2d->text_utf8(top, reason, color, TEXT_ALIGN_CENTER, font_default, 1.f);
-            im2d->text_utf8(bot, winner, color, TEXT_ALIGN_CENTER, font_default, 1.f);
+        // The search runs on the simulation thread, the move comes back
+        // with the other results in `update_simulation`
+        const bool has_clock = has_component(ctx, e, clock_id);
+        sim_command_t command = {
+            .type = SIM_COMMAND_SEARCH,
+            .has_clock = has_clock,
+            .board_entity = e,
+            .board = *board,
+            .search = ai_params(ctx, e),
+        };
+        if (has_clock)
+            command.clock = *(clock_component_t *)get_component(ctx, e, clock_id);
+        if (push_sim_command(&command))
+            board->move_pending = true;
+        else
+            log_print(LOG_WARN, "Simulation queue full, AI move delayed");
+        ++i;
+    }
 
-            break;
+    if (waiting.id != UINT64_MAX) {
+        ai_next_board = waiting_index + 1;
+        play_ai_move_now(ctx, waiting);
+    }
+}
+
+static void format_clock_time(char *buf, size_t size, int64_t ns)
+{
+    const int64_t tenths = ns / 100000000;
+    const int64_t seconds = tenths / 10;
+    // Show tenths when running low
+    if (seconds < 10)
+        snprintf(buf, size, "%i.%i", (int)seconds, (int)(tenths % 10));
+    else
+        snprintf(buf, size, "%i:%02i", (int)(seconds / 60), (int)(seconds % 60));
+}
+
+// Changes exactly when the text of `format_clock_time` does
+static inline int64_t clock_display_key(int64_t ns)
+{
+    const int64_t tenths = ns / 100000000;
+    return tenths < 100 ? tenths : tenths / 10 * 10;
+}
+
+static void draw_clocks(const clock_component_t *clock)
+{
+    extern struct font_t *font_default;
+
+    const uint64_t now = time_now_ns();
+    const rect_t window_r = window_api->rect();
+    const rect_t r = rect_inset((rect_t) { 0, 0, window_r.w, 60.f }, 30.f, 0);
+
+    for (int side = 0; side < 2; ++side) {
+        const uint8_t player = side == 0 ? PIECE_WHITE : PIECE_BLACK;
+        const bool active = clock->running && clock->running_player == player;
+        const vec4_t color = active ? (vec4_t) { 1, 1, 1, 1 } : (vec4_t) { 0.6f, 0.6f, 0.6f, 1 };
+        char time[16];
+        format_clock_time(time, sizeof(time), clock_remaining_ns(clock, player, now));
+        const char *text = arena_print(&frame_arena, "%s %s", side == 0 ? "White" : "Black", time);
+        im2d->text_utf8(r, text, color, side == 0 ? TEXT_ALIGN_LEFT : TEXT_ALIGN_RIGHT, font_default, 1.f);
+    }
+}
+
+enum {
+    // Simul overview cell size in pixels
+    HUD_CELL_WIDTH = 230,
+    HUD_CELL_HEIGHT = 22,
+};
+
+// Status line of one board in the simul overview, rebuilt only when the
+// state it shows changes
+typedef struct hud_cell_t {
+    entity_t board;
+    uint32_t move_count;
+    uint8_t game_state;
+    int64_t clock_keys[2];
+    char text[64];
+} hud_cell_t;
+
+static struct {
+    hud_cell_t *cells;
+    uint32_t num_cells;
+    uint32_t capacity;
+    // Cells rebuilt so far
+    uint64_t num_rebuilds;
+} simul_hud;
+
+static const char *game_result_text(uint8_t game_state)
+{
+    switch (game_state) {
+        case STATE_WHITE_WIN_BY_CHECKMATE: return "1-0 mate";
+        case STATE_BLACK_WIN_BY_CHECKMATE: return "0-1 mate";
+        case STATE_DRAW_BY_STALEMATE: return "1/2 stalemate";
+        case STATE_WHITE_WIN_ON_TIME: return "1-0 time";
+        case STATE_BLACK_WIN_ON_TIME: return "0-1 time";
+        default: return "";
+    }
+}
+
+static void build_hud_cell(hud_cell_t *cell, uint32_t index, const board_component_t *board, const clock_component_t *clock, uint64_t now)
+{
+    char status[32];
+    if (board->game_state == STATE_PLAYING) {
+        const char *side = board->current_player == PIECE_WHITE ? "W" : "B";
+        snprintf(status, sizeof(status), "%u.%s %+.2f", board->move_count / 2 + 1, side, rules_api->evaluate_board(board) / 100.f);
+    }
+    else {
+        snprintf(status, sizeof(status), "%s", game_result_text(board->game_state));
+    }
+
+    char clocks[32] = "";
+    if (clock) {
+        char white[16], black[16];
+        format_clock_time(white, sizeof(white), clock_remaining_ns(clock, PIECE_WHITE, now));
+        format_clock_time(black, sizeof(black), clock_remaining_ns(clock, PIECE_BLACK, now));
+        snprintf(clocks, sizeof(clocks), "  %s | %s", white, black);
+    }
+
+    snprintf(cell->text, sizeof(cell->text), "#%u  %s%s", index + 1, status, clocks);
+    ++simul_hud.num_rebuilds;
+}
+
+static void update_simul_hud(entity_ctx_o *ctx)
+{
+    const board_component_t *boards = component_data(ctx, board_id);
+    const uint64_t now = time_now_ns();
+
+    uint32_t n = 0;
+    entity_t e;
+    uint32_t i = 0;
+    while (find_next_component(ctx, board_id, (1ULL << board_id), &i, &e)) {
+        if (n == simul_hud.capacity) {
+            const uint32_t capacity = simul_hud.capacity ? simul_hud.capacity * 2 : 64;
+            hud_cell_t *cells = realloc(simul_hud.cells, capacity * sizeof(hud_cell_t));
+            if (!cells)
+                break;
+            simul_hud.cells = cells;
+            simul_hud.capacity = capacity;
         }
 
+        const board_component_t *board = &boards[i];
+        const clock_component_t *clock = has_component(ctx, e, clock_id) ? get_component(ctx, e, clock_id) : 0;
+        const int64_t clock_keys[2] = {
+            clock ? clock_display_key(clock_remaining_ns(clock, PIECE_WHITE, now)) : 0,
+            clock ? clock_display_key(clock_remaining_ns(clock, PIECE_BLACK, now)) : 0,
+        };
+
+        hud_cell_t *cell = &simul_hud.cells[n];
+        const bool changed = n >= simul_hud.num_cells || cell->board.id != e.id || cell->move_count != board->move_count
+            || cell->game_state != board->game_state || cell->clock_keys[0] != clock_keys[0] || cell->clock_keys[1] != clock_keys[1];
+        if (changed) {
+            cell->board = e;
+            cell->move_count = board->move_count;
+            cell->game_state = board->game_state;
+            cell->clock_keys[0] = clock_keys[0];
+            cell->clock_keys[1] = clock_keys[1];
+            build_hud_cell(cell, n, board, clock, now);
+        }
+
+        ++n;
         ++i;
     }
-}
\ No newline at end of file
+    simul_hud.num_cells = n;
+}
+
+static void draw_simul_hud(void)
+{
+    extern struct font_t *font_default;
+
+    const rect_t window_r = window_api->rect();
+    const float left = 30.f, top = 60.f;
+    const uint32_t num_columns = window_r.w > left * 2 + HUD_CELL_WIDTH ? (uint32_t)((window_r.w - left * 2) / HUD_CELL_WIDTH) : 1;
+    // Leave room for the latency overlay
+    const float bottom = window_r.h - (input_latency.show_overlay ? 60.f : 0.f);
+    const uint32_t num_rows = bottom > top + HUD_CELL_HEIGHT ? (uint32_t)((bottom - top) / HUD_CELL_HEIGHT) : 1;
+    const uint32_t num_slots = num_columns * num_rows;
+    // Last slot counts the boards that don't fit
+    const uint32_t num_shown = simul_hud.num_cells <= num_slots ? simul_hud.num_cells : num_slots - 1;
+
+    for (uint32_t k = 0; k < num_shown; ++k) {
+        const hud_cell_t *cell = &simul_hud.cells[k];
+        const rect_t r = {
+            left + (k % num_columns) * HUD_CELL_WIDTH,
+            top + (k / num_columns) * HUD_CELL_HEIGHT,
+            HUD_CELL_WIDTH,
+            HUD_CELL_HEIGHT,
+        };
+        const vec4_t color = cell->game_state == STATE_PLAYING ? (vec4_t) { 1, 1, 1, 1 } : (vec4_t) { 1, 0.8f, 0.3f, 1 };
+        im2d->text_utf8(r, cell->text, color, TEXT_ALIGN_LEFT, font_default, 0.6f);
+    }
+
+    if (num_shown < simul_hud.num_cells) {
+        const rect_t r = {
+            left + (num_shown % num_columns) * HUD_CELL_WIDTH,
+            top + (num_shown / num_columns) * HUD_CELL_HEIGHT,
+            HUD_CELL_WIDTH,
+            HUD_CELL_HEIGHT,
+        };
+        const char *text = arena_print(&frame_arena, "+%u more", simul_hud.num_cells - num_shown);
+        im2d->text_utf8(r, text, (vec4_t) { 0.6f, 0.6f, 0.6f, 1 }, TEXT_ALIGN_LEFT, font_default, 0.6f);
+    }
+}
+
+static const char *format_latency(const char *name, const latency_histogram_t *h)
+{
+    return arena_print(&frame_arena, "%s  p50 %.1f  p95 %.1f  p99 %.1f ms  (%llu)", name,
+        time_ns_to_ms(latency_percentile(h, 50)), time_ns_to_ms(latency_percentile(h, 95)),
+        time_ns_to_ms(latency_percentile(h, 99)), (unsigned long long)h->num_samples);
+}
+
+void set_input_latency_overlay(bool show)
+{
+    input_latency.show_overlay = show;
+}
+
+void log_input_latency(void)
+{
+    log_print(LOG_INFO, "Input latency: %s", format_latency("select", &input_latency.select));
+    log_print(LOG_INFO, "Input latency: %s", format_latency("move", &input_latency.move));
+}
+
+static void draw_input_latency(void)
+{
+    extern struct font_t *font_default;
+
+    const rect_t window_r = window_api->rect();
+    const vec4_t color = { 0.6f, 1, 0.6f, 1 };
+    const rect_t select_r = { 30.f, window_r.h - 60.f, window_r.w - 60.f, 22.f };
+    const rect_t move_r = { 30.f, window_r.h - 38.f, window_r.w - 60.f, 22.f };
+    im2d->text_utf8(select_r, format_latency("select", &input_latency.select), color, TEXT_ALIGN_LEFT, font_default, 0.6f);
+    im2d->text_utf8(move_r, format_latency("move", &input_latency.move), color, TEXT_ALIGN_LEFT, font_default, 0.6f);
+}
+
+void draw_board_ui(struct entity_ctx_o *ctx)
+{
+    // Clocks of the first timed board
+    {
+        const clock_component_t *clocks = component_data(ctx, clock_id);
+        entity_t e;
+        uint32_t i = 0;
+        if (find_next_component(ctx, clock_id, (1ULL << clock_id), &i, &e))
+            draw_clocks(&clocks[i]);
+    }
+
+    update_simul_hud(ctx);
+    draw_simul_hud();
+
+    if (input_latency.show_overlay)
+        draw_input_latency();
+}
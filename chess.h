@@ -3,6 +3,9 @@
 #include "entity_type.h"
 
 struct entity_ctx_o;
+struct frustum_t;
+struct board_component_t;
+struct puzzle_t;
 
 enum {
     // Pieces
@@ -25,15 +28,98 @@ enum {
     MASK_ROW = 0x70,
 };
 
-void create_board(struct entity_ctx_o *ctx, vec3_t world_offset);
+enum {
+    // Bits of `board_component_t.ai_players`
+    AI_PLAYER_WHITE = 0x1,
+    AI_PLAYER_BLACK = 0x2,
+};
+
+entity_t create_board(struct entity_ctx_o *ctx, vec3_t world_offset);
+// Destroys the board with its pieces and tiles. Its snapshot is freed once
+// no reader can still see it, see `destroy_board_snapshot_slot`.
+void destroy_board(struct entity_ctx_o *ctx, entity_t board);
+// Frees what is kept per world outside its components, such as board
+// snapshots and the move event ring. Call before the world is destroyed.
+void release_world(struct entity_ctx_o *ctx);
+
+// Boards whose centers fall in the same `size` by `size` cell share one
+// reflection probe. Zero gives every board its own. Applies to boards
+// created or moved afterwards.
+void set_reflection_probe_cell_size(float size);
+// Lets black pieces share the white meshes, tinted per instance. Needs a
+// pieces shader that applies `mesh_component_t.tint`, off by default.
+// Applies to pieces created afterwards.
+void set_black_piece_tint(bool enabled);
+// Number of reduced detail meshes exported for each piece, zero if none.
+// Applies to pieces created afterwards, see `select_mesh_lods`.
+void set_piece_lod_levels(uint32_t num_levels);
 
+typedef struct premove_stats_t {
+    uint64_t num_applied;
+    // Premoves that were illegal once the opponent had moved
+    uint64_t num_rejected;
+    // From the opponent's move until the premoved piece starts moving
+    uint64_t total_latency_ns;
+    uint64_t max_latency_ns;
+} premove_stats_t;
+
+// Call every frame with the entity under the cursor. Legal moves of a
+// hovered piece are computed ahead, so pressing it shows them instantly.
+void on_entity_hovered(struct entity_ctx_o *ctx, entity_t e);
 void on_entity_pressed(struct entity_ctx_o *ctx, entity_t e);
+// Pressing pieces and tiles while the opponent is to move queues a premove,
+// played as soon as the opponent's move is done if it's still legal
+premove_stats_t get_premove_stats(void);
+
+// Releases strings and other scratch memory of the previous frame.
+// Call at the start of every frame.
+void reset_frame_scratch(void);
+
+// Moves the board with all its pieces and tiles
+void set_board_position(struct entity_ctx_o *ctx, entity_t board, vec3_t pos);
+
+// Flags boards outside `frustum` as not visible. Their tiles aren't updated
+// and their piece animations skip to the end, rules and clocks still run.
+// Call before `update_pieces`. Returns the number of visible boards.
+uint32_t cull_boards(struct entity_ctx_o *ctx, const struct frustum_t *frustum);
+
+// Applies moves finished by the simulation thread, see `start_simulation_thread`.
+// Call before `update_pieces`.
+void update_simulation(struct entity_ctx_o *ctx);
+
+// Replaces the position of an existing board with the rules state of
+// `state`, rebuilding its pieces. Fails while the board has a move with the
+// simulation thread. With the thread running, the board waits for it to
+// publish the new position like for a move.
+bool set_board_state(struct entity_ctx_o *ctx, entity_t board, const struct board_component_t *state);
+
+// Sets up a puzzle read with `read_puzzle` on an existing board. The player
+// takes the side not to move, the opponent's moves are played by
+// `update_puzzles`, and moves that aren't the solution are refused.
+bool load_puzzle(struct entity_ctx_o *ctx, entity_t board, const struct puzzle_t *puzzle);
+// Call before `update_pieces`
+void update_puzzles(struct entity_ctx_o *ctx);
 
 void update_pieces(struct entity_ctx_o *ctx, float dt);
 void update_tiles(struct entity_ctx_o *ctx, float dt);
+// Searches and plays a move for every board where an AI player is to move.
+// With the simulation thread running the search runs there and the move is
+// played by `update_simulation`.
+void update_ai(struct entity_ctx_o *ctx);
+
+// Adds a running clock with `base_ms` per side and `increment_ms` per move
+void add_board_clock(struct entity_ctx_o *ctx, entity_t board, uint32_t base_ms, uint32_t increment_ms);
+// Detects flag fall on all clocks, timing is independent of the frame delta
+void update_clocks(struct entity_ctx_o *ctx);
 
 void draw_board_ui(struct entity_ctx_o *ctx);
 
+// Press to highlight and press to piece animation latency of this session,
+// as p50/p95/p99. Logged on request, e.g. at shutdown, and optionally drawn
+// by `draw_board_ui`.
+void log_input_latency(void);
+void set_input_latency_overlay(bool show);
+
 static inline const char *get_piece_name(int piece_mask)
 {
     switch (piece_mask & MASK_TYPE) {
@@ -18,6 +18,12 @@ static void serialize_transform(serializer_o *s, transform_t *data)
     emit_vec3(s, data->scl);
 }
 
+static void serialize_hierarchy(serializer_o *s, hierarchy_component_t *data)
+{
+    emit_comment(s, "hierarchy");
+    serialize_transform(s, &data->local);
+}
+
 static void serialize_light(serializer_o *s, light_component_t *light)
 {
     emit_comment(s, "light");
@@ -53,6 +59,13 @@ static void serialize_mesh(serializer_o *s, mesh_component_t *mesh)
     for (uint32_t i = 0; i < mesh->num_materials; ++i) {
         emit_string(s, mesh->material_path[i], 64);
     }
+    emit_comment(s, "lods");
+    emit_int(s, mesh->num_lods);
+    for (uint32_t i = 0; i < mesh->num_lods; ++i) {
+        emit_string(s, mesh->lod_path[i], 64);
+    }
+    emit_comment(s, "tint");
+    emit_vec4(s, mesh->tint);
 }
 
 static void serialize_piece(serializer_o *s, piece_component_t *piece)
@@ -71,6 +84,29 @@ static void serialize_board(serializer_o *s, board_component_t *board)
     emit_comment(s, "board");
 }
 
+static void serialize_clock(serializer_o *s, clock_component_t *clock)
+{
+    emit_comment(s, "clock");
+    emit_comment(s, "increment");
+    emit_float(s, (float)(clock->increment_ns / 1000000000.0));
+}
+
+static void serialize_probe(serializer_o *s, probe_component_t *probe)
+{
+    emit_comment(s, "probe");
+}
+
+static void serialize_puzzle(serializer_o *s, puzzle_component_t *puzzle)
+{
+    emit_comment(s, "puzzle");
+    emit_int(s, puzzle->index);
+}
+
+static inline uint32_t mesh_triangle_count(const mesh_t *mesh)
+{
+    return mesh->num_indices / 3;
+}
+
 static void load_mesh_component(entity_ctx_o *ctx, entity_t owner, mesh_component_t *c)
 {
     extern struct asset_catalog_t *meshes;
@@ -82,6 +118,7 @@ static void load_mesh_component(entity_ctx_o *ctx, entity_t owner, mesh_componen
         return;
     }
     c->data = mesh;
+    c->lod_triangles[0] = mesh_triangle_count(mesh);
 
     if (c->num_materials > 0 && mesh->num_wanted_materials != c->num_materials) {
         log_print(LOG_WARN, "Expected %i materials but got %i for mesh '%s'", 
@@ -92,6 +129,17 @@ static void load_mesh_component(entity_ctx_o *ctx, entity_t owner, mesh_componen
         material_t *mat = (m < c->num_materials ? load_material_from_file(materials, c->material_path[m]) : default_material);
         c->materials[m] = *mat;
     }
+
+    // Detail levels are optional; stop at the first one that is missing
+    for (uint32_t l = 0; l < c->num_lods; ++l) {
+        c->lod_data[l] = load_mesh_from_file(meshes, c->lod_path[l]);
+        if (c->lod_data[l] == 0) {
+            log_print(LOG_WARN, "Missing detail level %i '%s', using %i levels", l + 1, c->lod_path[l], l + 1);
+            c->num_lods = l;
+            break;
+        }
+        c->lod_triangles[l + 1] = mesh_triangle_count(c->lod_data[l]);
+    }
 }
 
 void register_all_components(entity_ctx_o *ctx)
@@ -107,6 +155,21 @@ void register_all_components(entity_ctx_o *ctx)
         .serialize_func = serialize_transform,
     };
 
+    component_i *hierarchy = &(component_i) {
+        .component_size = sizeof(hierarchy_component_t),
+        .default_data = &(hierarchy_component_t) {
+            .parent = NO_PARENT,
+            .local = {
+                .pos = make_vec3(0, 0, 0),
+                .rot = make_vec4(0, 0, 0, 1),
+                .scl = make_vec3(1, 1, 1),
+            },
+            .dirty = true,
+        },
+        .name = "Hierarchy Component",
+        .serialize_func = serialize_hierarchy,
+    };
+
     component_i *light = &(component_i) {
         .component_size = sizeof(light_component_t),
         .default_data = &(light_component_t) {
@@ -129,6 +192,7 @@ void register_all_components(entity_ctx_o *ctx)
         .component_size = sizeof(mesh_component_t),
         .default_data = &(mesh_component_t) {
             .visibility_mask = VIEWER_MASK_MAIN | VIEWER_MASK_SHADOW,
+            .tint = make_vec4(1, 1, 1, 1),
         },
         .name = "Mesh Component",
         .load_func = load_mesh_component,
@@ -162,6 +226,8 @@ void register_all_components(entity_ctx_o *ctx)
 				0x6, 0x2, 0x5, 0x3, 0x7, 0x5, 0x2, 0x6, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
             },
             .selected_piece = (entity_t) { .id = UINT64_MAX },
+            .reflection_probe = (entity_t) { .id = UINT64_MAX },
+            .visible = true,
             .castle_bits = 0xf,
             .current_player = 0x0,
             .move_count = 0,
@@ -169,6 +235,24 @@ void register_all_components(entity_ctx_o *ctx)
         .serialize_func = serialize_board,
     };
 
+    component_i *clock = &(component_i) {
+        .component_size = sizeof(clock_component_t),
+        .name = "Clock Component",
+        .serialize_func = serialize_clock,
+    };
+
+    component_i *probe = &(component_i) {
+        .component_size = sizeof(probe_component_t),
+        .name = "Probe Component",
+        .serialize_func = serialize_probe,
+    };
+
+    component_i *puzzle = &(component_i) {
+        .component_size = sizeof(puzzle_component_t),
+        .name = "Puzzle Component",
+        .serialize_func = serialize_puzzle,
+    };
+
     transform_id = register_component_type(ctx, transform);
     volume_id =    register_component_type(ctx, volume);
     piece_id =     register_component_type(ctx, piece);
@@ -176,4 +260,8 @@ void register_all_components(entity_ctx_o *ctx)
     mesh_id =      register_component_type(ctx, mesh);
     tile_id =      register_component_type(ctx, tile);
     board_id =     register_component_type(ctx, board);
+    clock_id =     register_component_type(ctx, clock);
+    hierarchy_id = register_component_type(ctx, hierarchy);
+    probe_id =     register_component_type(ctx, probe);
+    puzzle_id =    register_component_type(ctx, puzzle);
 }
\ No newline at end of file
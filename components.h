@@ -2,8 +2,10 @@
 #include "foundation/basic.h"
 #include "render/material.h"
 #include "entity_type.h"
+#include "entity.h"
 
 struct entity_ctx_o;
+struct board_snapshot_slot_t;
 
 // Component handles
 uint32_t transform_id;
@@ -13,6 +15,10 @@ uint32_t mesh_id;
 uint32_t piece_id;
 uint32_t tile_id;
 uint32_t board_id;
+uint32_t clock_id;
+uint32_t hierarchy_id;
+uint32_t probe_id;
+uint32_t puzzle_id;
 
 enum {
     LIGHT_TYPE_POINT,
@@ -42,6 +48,8 @@ typedef struct volume_component_t {
 
 enum {
     MAX_NUM_MATERIALS = 16,
+    // Detail levels of a mesh, including `mesh_path` itself
+    MAX_MESH_LODS = 4,
 };
 
 typedef struct mesh_component_t {
@@ -49,10 +57,46 @@ typedef struct mesh_component_t {
     uint32_t num_materials;
     char material_path[MAX_NUM_MATERIALS][64];
     uint64_t visibility_mask;
+    // Per instance color multiplier, lets instances of different colors share one mesh
+    vec4_t tint;
     struct mesh_t *data;
     struct material_t materials[MAX_NUM_MATERIALS];
+    // Interned mesh and material paths, see `intern_path`. Zero until the
+    // draw list needs them, reset when the paths change.
+    uint32_t mesh_key;
+    uint32_t material_key;
+    // Lower detail meshes, `lod_path[0]` is level 1. Levels that fail to
+    // load are dropped.
+    uint32_t num_lods;
+    char lod_path[MAX_MESH_LODS - 1][64];
+    struct mesh_t *lod_data[MAX_MESH_LODS - 1];
+    uint32_t lod_keys[MAX_MESH_LODS - 1];
+    // Triangles of each level, `lod_triangles[0]` being the full mesh.
+    // Recorded when the level loads.
+    uint32_t lod_triangles[MAX_MESH_LODS];
+    // Level to draw, picked every frame by `select_mesh_lods`
+    uint8_t lod;
 } mesh_component_t;
 
+// Parent of an entity without one
+#define NO_PARENT ((entity_t) { .id = UINT64_MAX })
+
+// Places the entity relative to `parent`. The entity's `transform_t` is a
+// cache of the world transform, rebuilt by `update_transforms` only when
+// this entity or one of its parents changed.
+typedef struct hierarchy_component_t {
+    entity_t parent;
+    transform_t local;
+    // Set when `local` changes
+    bool dirty;
+    // Bumped every time the world transform is rebuilt
+    uint32_t version;
+    // Parent `version` the world transform was built from
+    uint32_t parent_version;
+    // Frame of the `dirty_transforms_t` this entity was last listed in, plus one
+    uint32_t listed_frame;
+} hierarchy_component_t;
+
 typedef struct piece_component_t {
     // Piece color and type mask
     uint8_t mask;
@@ -61,11 +105,11 @@ typedef struct piece_component_t {
     // Position on board
     int board_position;
     // True if the piece should animate movement
-    // between `world_pos_from` and `world_pos_true`
+    // between `pos_from` and `pos_to`, relative to the board
     bool want_to_move;
     float move_t;
-    vec3_t world_pos_from;
-    vec3_t world_pos_to;
+    vec3_t pos_from;
+    vec3_t pos_to;
 } piece_component_t;
 
 typedef struct tile_component_t {
@@ -86,13 +130,112 @@ typedef struct board_component_t {
     uint32_t move_count;
     // Non-zero if game is over (win/draw)
     uint8_t game_state;
+    // Sides played by the computer, see `AI_PLAYER_WHITE`
+    uint8_t ai_players;
+    // Reflection probe shared with nearby boards
+    entity_t reflection_probe;
+    // Cleared by `cull_boards` while the board is off-screen
+    bool visible;
+    // Copy of the rules state for other threads, republished after every
+    // move, see `load_board_snapshot`
+    struct board_snapshot_slot_t *snapshot;
+    // Set while a move is with the simulation thread, input and AI wait for it
+    bool move_pending;
+    // Move queued by `premove_player` during the opponent's turn, tried
+    // right after the opponent moves
+    bool has_premove;
+    uint8_t premove_player;
+    uint8_t premove_from;
+    uint8_t premove_to;
+    // When the player selected a piece or made a move, zero once the
+    // highlight or the piece animation has started
+    uint64_t select_press_ns;
+    uint64_t move_press_ns;
 } board_component_t;
 
+// Lives on a reflection probe shared by the boards of one grid cell. The
+// probe sits at the centroid of its boards and covers all of them.
+typedef struct probe_component_t {
+    int32_t cell_x;
+    int32_t cell_z;
+    uint32_t num_boards;
+    // Sum of member board centers
+    vec3_t center_sum;
+    // World space union of the member board volumes
+    vec3_t bb_min;
+    vec3_t bb_max;
+} probe_component_t;
+
+// Lives on the board entity. Kept apart from `board_component_t` so that
+// ticking all clocks is a single pass over a small contiguous array.
+typedef struct clock_component_t {
+    // Remaining time per side at the start of the current turn,
+    // indexed by `player / 8`
+    int64_t remaining_ns[2];
+    uint64_t increment_ns;
+    // Monotonic timestamp when the current turn started
+    uint64_t turn_start_ns;
+    uint8_t running_player;
+    bool running;
+    // Set once the running player's time has run out
+    bool flagged;
+} clock_component_t;
+
+enum {
+    // Longer solutions are skipped when indexing a puzzle file
+    PUZZLE_MAX_MOVES = 32,
+};
+
+enum {
+    PUZZLE_SOLVING,
+    PUZZLE_SOLVED,
+};
+
+// Lives on a board playing a puzzle, see `load_puzzle`. The solution
+// alternates the opponent's replies with the moves of `player`, starting
+// with the opponent's move leading into the puzzle.
+typedef struct puzzle_component_t {
+    // Position in the rating sorted puzzle index
+    uint32_t index;
+    uint16_t rating;
+    uint8_t player;
+    uint8_t state;
+    uint8_t num_moves;
+    // Next solution move to be played
+    uint8_t next_move;
+    uint8_t from[PUZZLE_MAX_MOVES];
+    uint8_t to[PUZZLE_MAX_MOVES];
+    // Legal moves of `player` that weren't the solution, these are refused
+    uint32_t num_mistakes;
+} puzzle_component_t;
+
 void register_all_components(struct entity_ctx_o *ctx);
 
 static inline void set_mesh_path(mesh_component_t *c, const char *path)
 {
     snprintf(c->mesh_path, 64, "%s", path);
+    c->mesh_key = 0;
+}
+
+// Sets the path of detail level `level`, 1 being the first reduced level
+static inline void set_lod_mesh_path(mesh_component_t *c, const char *path, uint32_t level)
+{
+    if (level == 0 || level >= MAX_MESH_LODS)
+        return;
+    snprintf(c->lod_path[level - 1], 64, "%s", path);
+    c->lod_keys[level - 1] = 0;
+    if (level > c->num_lods)
+        c->num_lods = level;
+}
+
+static inline struct mesh_t *get_lod_mesh(const mesh_component_t *c)
+{
+    return c->lod > 0 && c->lod <= c->num_lods ? c->lod_data[c->lod - 1] : c->data;
+}
+
+static inline uint32_t get_lod_triangles(const mesh_component_t *c)
+{
+    return c->lod > 0 && c->lod <= c->num_lods ? c->lod_triangles[c->lod] : c->lod_triangles[0];
 }
 
 static inline void set_material_path(mesh_component_t *c, const char *path, uint32_t idx)
@@ -100,4 +243,5 @@ static inline void set_material_path(mesh_component_t *c, const char *path, uint
     snprintf(c->material_path[idx], 64, "%s", path);
     if (idx >= c->num_materials)
         c->num_materials = idx + 1;
+    c->material_key = 0;
 }
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include "draw_list.h"
+#include "components.h"
+#include "entity.h"
+#include "render/mesh.h"
+
+// Interned paths; `paths[id - 1]` is the string for `id`
+static struct {
+    uint32_t *slots;
+    uint32_t num_slots;
+    char **paths;
+    uint32_t num_paths;
+} interned;
+
+static uint32_t hash_path(const char *path)
+{
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (const char *c = path; *c; ++c)
+        h = (h ^ (uint8_t)*c) * 16777619u;
+    return h;
+}
+
+static bool grow_interned(void)
+{
+    const uint32_t num_slots = interned.num_slots ? interned.num_slots * 2 : 256;
+    uint32_t *slots = calloc(num_slots, sizeof(uint32_t));
+    char **paths = realloc(interned.paths, num_slots / 2 * sizeof(char *));
+    if (!slots || !paths) {
+        free(slots);
+        if (paths)
+            interned.paths = paths;
+        return false;
+    }
+
+    for (uint32_t id = 1; id <= interned.num_paths; ++id) {
+        uint32_t slot = hash_path(paths[id - 1]) & (num_slots - 1);
+        while (slots[slot])
+            slot = (slot + 1) & (num_slots - 1);
+        slots[slot] = id;
+    }
+
+    free(interned.slots);
+    interned.slots = slots;
+    interned.num_slots = num_slots;
+    interned.paths = paths;
+    return true;
+}
+
+uint32_t intern_path(const char *path)
+{
+    // Keep the load factor at or below one half
+    if (interned.num_paths >= interned.num_slots / 2 && !grow_interned())
+        return 0;
+
+    uint32_t slot = hash_path(path) & (interned.num_slots - 1);
+    for (; interned.slots[slot]; slot = (slot + 1) & (interned.num_slots - 1)) {
+        const uint32_t id = interned.slots[slot];
+        if (strcmp(interned.paths[id - 1], path) == 0)
+            return id;
+    }
+
+    char *copy = strdup(path);
+    if (!copy)
+        return 0;
+    interned.paths[interned.num_paths++] = copy;
+    interned.slots[slot] = interned.num_paths;
+    return interned.num_paths;
+}
+
+const char *interned_path(uint32_t id)
+{
+    return id > 0 && id <= interned.num_paths ? interned.paths[id - 1] : "";
+}
+
+static uint32_t material_key(const mesh_component_t *mesh)
+{
+    if (mesh->num_materials <= 1)
+        return intern_path(mesh->num_materials ? mesh->material_path[0] : "");
+
+    // Material sets are interned as one joined path
+    char joined[MAX_NUM_MATERIALS * 65];
+    size_t n = 0;
+    for (uint32_t i = 0; i < mesh->num_materials && i < MAX_NUM_MATERIALS; ++i)
+        n += snprintf(joined + n, sizeof(joined) - n, "%s%s", i ? "|" : "", mesh->material_path[i]);
+    return intern_path(joined);
+}
+
+// Interned path of the detail level picked for this frame
+static uint32_t lod_mesh_key(mesh_component_t *mesh)
+{
+    if (mesh->lod == 0 || mesh->lod > mesh->num_lods) {
+        if (mesh->mesh_key == 0)
+            mesh->mesh_key = intern_path(mesh->mesh_path);
+        return mesh->mesh_key;
+    }
+
+    uint32_t *key = &mesh->lod_keys[mesh->lod - 1];
+    if (*key == 0)
+        *key = intern_path(mesh->lod_path[mesh->lod - 1]);
+    return *key;
+}
+
+static void pack_transform(const transform_t *tm, draw_instance_t *out)
+{
+    const float x = tm->rot.x, y = tm->rot.y, z = tm->rot.z, w = tm->rot.w;
+    const float *s = &tm->scl.x;
+    const float r[9] = {
+        1.f - 2.f * (y * y + z * z), 2.f * (x * y - z * w), 2.f * (x * z + y * w),
+        2.f * (x * y + z * w), 1.f - 2.f * (x * x + z * z), 2.f * (y * z - x * w),
+        2.f * (x * z - y * w), 2.f * (y * z + x * w), 1.f - 2.f * (x * x + y * y),
+    };
+    const float *p = &tm->pos.x;
+    for (int row = 0; row < 3; ++row) {
+        out->m[row * 4 + 0] = r[row * 3 + 0] * s[0];
+        out->m[row * 4 + 1] = r[row * 3 + 1] * s[1];
+        out->m[row * 4 + 2] = r[row * 3 + 2] * s[2];
+        out->m[row * 4 + 3] = p[row];
+    }
+}
+
+typedef struct sort_item_t {
+    // Material key in the high bits so batches sharing a material are adjacent
+    uint64_t key;
+    uint32_t component;
+    entity_t e;
+} sort_item_t;
+
+static inline uint32_t sort_item_mesh_key(const sort_item_t *item)
+{
+    return (uint32_t)item->key;
+}
+
+// Stable LSD radix sort by `key`, a byte per pass. Interned ids are small,
+// so most passes see a single digit value and are skipped.
+static sort_item_t *sort_items(sort_item_t *items, sort_item_t *tmp, uint32_t n)
+{
+    uint64_t all_keys = 0;
+    for (uint32_t i = 0; i < n; ++i)
+        all_keys |= items[i].key;
+
+    for (uint32_t shift = 0; shift < 64 && (all_keys >> shift) != 0; shift += 8) {
+        uint32_t offsets[256] = { 0 };
+        for (uint32_t i = 0; i < n; ++i)
+            ++offsets[(items[i].key >> shift) & 0xff];
+        if (offsets[(items[0].key >> shift) & 0xff] == n)
+            continue;
+
+        uint32_t sum = 0;
+        for (uint32_t d = 0; d < 256; ++d) {
+            const uint32_t count = offsets[d];
+            offsets[d] = sum;
+            sum += count;
+        }
+        for (uint32_t i = 0; i < n; ++i)
+            tmp[offsets[(items[i].key >> shift) & 0xff]++] = items[i];
+
+        sort_item_t *swap = items;
+        items = tmp;
+        tmp = swap;
+    }
+    return items;
+}
+
+void build_draw_list(entity_ctx_o *ctx, draw_list_t *list, uint64_t visibility_mask)
+{
+    arena_reset(&list->arena);
+    list->batches = 0;
+    list->instances = 0;
+    list->stats = (draw_list_stats_t) { 0 };
+
+    mesh_component_t *meshes = component_data(ctx, mesh_id);
+    const uint64_t mask = (1ULL << mesh_id | 1ULL << transform_id);
+
+    uint32_t num_components = 0;
+    {
+        entity_t e;
+        uint32_t i = 0;
+        while (find_next_component(ctx, mesh_id, mask, &i, &e)) {
+            ++num_components;
+            ++i;
+        }
+    }
+    if (num_components == 0)
+        return;
+
+    sort_item_t *items = arena_push_array(&list->arena, sort_item_t, num_components);
+    sort_item_t *sort_tmp = arena_push_array(&list->arena, sort_item_t, num_components);
+    uint32_t num_items = 0;
+
+    entity_t e;
+    uint32_t i = 0;
+    while (find_next_component(ctx, mesh_id, mask, &i, &e)) {
+        mesh_component_t *mesh = &meshes[i];
+        if ((mesh->visibility_mask & visibility_mask) == 0 || get_lod_mesh(mesh) == 0) {
+            ++list->stats.num_skipped;
+            ++i;
+            continue;
+        }
+
+        if (mesh->material_key == 0)
+            mesh->material_key = material_key(mesh);
+
+        items[num_items++] = (sort_item_t) {
+            .key = (uint64_t)mesh->material_key << 32 | lod_mesh_key(mesh),
+            .component = i,
+            .e = e,
+        };
+        ++i;
+    }
+
+    if (num_items == 0)
+        return;
+    items = sort_items(items, sort_tmp, num_items);
+
+    list->instances = arena_push_array(&list->arena, draw_instance_t, num_items);
+    // At most one batch per instance
+    list->batches = arena_push_array(&list->arena, draw_batch_t, num_items);
+
+    // One bit per interned path, to count distinct meshes
+    const uint32_t num_words = interned.num_paths / 64 + 1;
+    uint64_t *seen_meshes = arena_push_array(&list->arena, uint64_t, num_words);
+    memset(seen_meshes, 0, num_words * sizeof(uint64_t));
+
+    draw_batch_t *batch = 0;
+    for (uint32_t k = 0; k < num_items; ++k) {
+        const mesh_component_t *mesh = &meshes[items[k].component];
+        const uint32_t mesh_key = sort_item_mesh_key(&items[k]);
+        pack_transform(get_component(ctx, items[k].e, transform_id), &list->instances[k]);
+        list->instances[k].tint = mesh->tint;
+        list->stats.triangles_submitted += get_lod_triangles(mesh);
+
+        if (!batch || batch->mesh_key != mesh_key || batch->material_key != mesh->material_key) {
+            list->stats.material_changes += !batch || batch->material_key != mesh->material_key;
+            list->stats.mesh_changes += !batch || batch->mesh_key != mesh_key;
+            batch = &list->batches[list->stats.num_batches++];
+            *batch = (draw_batch_t) {
+                .mesh_key = mesh_key,
+                .material_key = mesh->material_key,
+                .mesh = get_lod_mesh(mesh),
+                .materials = mesh->materials,
+                .num_materials = mesh->num_materials,
+                .first_instance = k,
+            };
+
+            uint64_t *word = &seen_meshes[mesh_key / 64];
+            const uint64_t bit = 1ULL << (mesh_key % 64);
+            list->stats.num_unique_meshes += (*word & bit) == 0;
+            *word |= bit;
+        }
+        ++batch->num_instances;
+    }
+    list->stats.num_instances = num_items;
+}
+
+void free_draw_list(draw_list_t *list)
+{
+    arena_free(&list->arena);
+    *list = (draw_list_t) { 0 };
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "foundation/basic.h"
+#include "arena.h"
+
+struct entity_ctx_o;
+struct mesh_t;
+struct material_t;
+
+typedef struct draw_instance_t {
+    // World transform, 3x4 row major
+    float m[12];
+    // See `mesh_component_t.tint`
+    vec4_t tint;
+} draw_instance_t;
+
+// Instances sharing mesh and materials, drawn with one call
+typedef struct draw_batch_t {
+    uint32_t mesh_key;
+    uint32_t material_key;
+    struct mesh_t *mesh;
+    // Materials of the first instance, valid until mesh components change
+    const struct material_t *materials;
+    uint32_t num_materials;
+    uint32_t first_instance;
+    uint32_t num_instances;
+} draw_batch_t;
+
+typedef struct draw_list_stats_t {
+    uint32_t num_batches;
+    uint32_t num_instances;
+    // Mesh components skipped by the visibility mask or not loaded
+    uint32_t num_skipped;
+    // Binds needed to walk the batches in order
+    uint32_t material_changes;
+    uint32_t mesh_changes;
+    // Distinct meshes referenced by the batches
+    uint32_t num_unique_meshes;
+    // Triangles of all instances, at their selected detail level
+    uint64_t triangles_submitted;
+} draw_list_stats_t;
+
+typedef struct draw_list_t {
+    // Holds batches and instances until the next build
+    arena_t arena;
+    draw_batch_t *batches;
+    draw_instance_t *instances;
+    draw_list_stats_t stats;
+} draw_list_t;
+
+// Groups all mesh components visible in `visibility_mask` by (mesh,
+// material) into batches, sorted by material and then mesh.
+void build_draw_list(struct entity_ctx_o *ctx, draw_list_t *list, uint64_t visibility_mask);
+void free_draw_list(draw_list_t *list);
+
+// Small stable id for an asset path, equal paths give equal ids. Zero is never returned.
+uint32_t intern_path(const char *path);
+const char *interned_path(uint32_t id);
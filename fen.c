@@ -0,0 +1,216 @@
+#include "fen.h"
+#include "move_tables.h"
+
+bool next_fen_field(const char **p, const char *end, const char **field, size_t *length)
+{
+    const char *s = *p;
+    while (s < end && *s == ' ')
+        ++s;
+    const char *e = s;
+    while (e < end && *e != ' ')
+        ++e;
+    *p = e;
+    *field = s;
+    *length = (size_t)(e - s);
+    return e > s;
+}
+
+static uint8_t piece_from_fen(char c)
+{
+    const uint8_t color = c >= 'a' ? PIECE_BLACK : PIECE_WHITE;
+    switch (c | 0x20) {
+        case 'p': return PIECE_PAWN | color;
+        case 'n': return PIECE_KNIGHT | color;
+        case 'b': return PIECE_BISHOP | color;
+        case 'r': return PIECE_ROOK | color;
+        case 'q': return PIECE_QUEEN | color;
+        case 'k': return PIECE_KING | color;
+        default: return 0;
+    }
+}
+
+// Letters by castle bit, see `castle_rook_from`
+static const char castle_letters[4] = { 'Q', 'K', 'q', 'k' };
+
+static bool can_still_castle(const board_component_t *board, int bit)
+{
+    const uint8_t color = bit < 2 ? PIECE_WHITE : PIECE_BLACK;
+    return board->indices[castle_king_from[bit]] == (PIECE_KING | color)
+        && board->indices[castle_rook_from[bit]] == (PIECE_ROOK | color);
+}
+
+void set_start_position(board_component_t *board)
+{
+    static const uint8_t start_indices[64 * 2] = {
+        0xe, 0xa, 0xd, 0xb, 0xf, 0xd, 0xa, 0xe, 0, 0, 0, 0, 0, 0, 0, 0,
+        0x9, 0x9, 0x9, 0x9, 0x9, 0x9, 0x9, 0x9, 0, 0, 0, 0, 0, 0, 0, 0,
+        [0x60] = 0x1, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1, 0x1, 0, 0, 0, 0, 0, 0, 0, 0,
+        0x6, 0x2, 0x5, 0x3, 0x7, 0x5, 0x2, 0x6,
+    };
+    memcpy(board->indices, start_indices, sizeof(start_indices));
+    board->current_player = PIECE_WHITE;
+    board->castle_bits = 0xf;
+    board->en_passant_pos = 0;
+    board->move_count = 0;
+    board->game_state = STATE_PLAYING;
+}
+
+int parse_square(const char *s)
+{
+    if (s[0] < 'a' || s[0] > 'h' || s[1] < '1' || s[1] > '8')
+        return -1;
+    return (7 - (s[0] - 'a')) + (8 - (s[1] - '0')) * 16;
+}
+
+void format_square(int square, char *out)
+{
+    out[0] = (char)('a' + 7 - square % 16);
+    out[1] = (char)('8' - square / 16);
+}
+
+bool parse_fen(const char *fen, size_t length, board_component_t *board)
+{
+    const char *p = fen;
+    const char *end = fen + length;
+    const char *field;
+    size_t n;
+
+    // Piece placement, rank 8 first
+    if (!next_fen_field(&p, end, &field, &n))
+        return false;
+    memset(board->indices, 0, sizeof(board->indices));
+    int file = 0;
+    int row = 0;
+    uint32_t num_kings[2] = { 0 };
+    for (size_t i = 0; i < n; ++i) {
+        const char c = field[i];
+        if (c == '/') {
+            if (file != 8 || ++row > 7)
+                return false;
+            file = 0;
+        }
+        else if (c >= '1' && c <= '8') {
+            file += c - '0';
+            if (file > 8)
+                return false;
+        }
+        else {
+            const uint8_t piece = piece_from_fen(c);
+            if (!piece || file > 7)
+                return false;
+            if ((piece & MASK_TYPE) == PIECE_KING)
+                ++num_kings[piece / 8];
+            board->indices[(7 - file) + row * 16] = piece;
+            ++file;
+        }
+    }
+    if (row != 7 || file != 8 || num_kings[0] != 1 || num_kings[1] != 1)
+        return false;
+
+    if (!next_fen_field(&p, end, &field, &n) || n != 1 || (field[0] != 'w' && field[0] != 'b'))
+        return false;
+    board->current_player = field[0] == 'w' ? PIECE_WHITE : PIECE_BLACK;
+
+    if (!next_fen_field(&p, end, &field, &n))
+        return false;
+    board->castle_bits = 0;
+    for (size_t i = 0; i < n; ++i) {
+        for (int bit = 0; bit < 4; ++bit) {
+            if (field[i] == castle_letters[bit] && can_still_castle(board, bit))
+                board->castle_bits |= 1 << bit;
+        }
+    }
+
+    // The rules keep the pawn that can be taken, not the square behind it
+    if (!next_fen_field(&p, end, &field, &n))
+        return false;
+    board->en_passant_pos = 0;
+    if (n == 2) {
+        const int target = parse_square(field);
+        const uint8_t opponent = opponent_of(board->current_player);
+        const int pawn = target + (opponent == PIECE_BLACK ? 16 : -16);
+        if (target >= 0 && !(pawn & 0x88) && board->indices[pawn] == (PIECE_PAWN | opponent))
+            board->en_passant_pos = pawn;
+    }
+
+    // The halfmove clock isn't tracked, the move number is optional
+    board->move_count = board->current_player == PIECE_BLACK;
+    if (next_fen_field(&p, end, &field, &n) && next_fen_field(&p, end, &field, &n)) {
+        const int move_number = atoi(field);
+        if (move_number > 1)
+            board->move_count += (uint32_t)(move_number - 1) * 2;
+    }
+
+    board->game_state = STATE_PLAYING;
+    return true;
+}
+
+
+static char fen_piece_letter(uint8_t piece)
+{
+    static const char letters[8] = { 0, 'p', 'n', 'k', 0, 'b', 'r', 'q' };
+    const char c = letters[piece & MASK_TYPE];
+    return (piece & MASK_COLOR) == PIECE_WHITE ? c - 0x20 : c;
+}
+
+uint32_t format_fen(const board_component_t *board, char *out, bool with_move_numbers)
+{
+    char *s = out;
+    for (int row = 0; row < 8; ++row) {
+        int empty = 0;
+        for (int file = 0; file < 8; ++file) {
+            const uint8_t piece = board->indices[(7 - file) + row * 16];
+            if (!piece) {
+                ++empty;
+                continue;
+            }
+            if (empty)
+                *s++ = (char)('0' + empty);
+            empty = 0;
+            *s++ = fen_piece_letter(piece);
+        }
+        if (empty)
+            *s++ = (char)('0' + empty);
+        if (row < 7)
+            *s++ = '/';
+    }
+
+    *s++ = ' ';
+    *s++ = board->current_player == PIECE_WHITE ? 'w' : 'b';
+
+    // The rules keep a right until the king or rook moves from its corner,
+    // FEN order is KQkq
+    *s++ = ' ';
+    const char *castle_start = s;
+    static const int fen_castle_order[4] = { 1, 0, 3, 2 };
+    for (int i = 0; i < 4; ++i) {
+        const int bit = fen_castle_order[i];
+        if ((board->castle_bits >> bit & 1) && can_still_castle(board, bit))
+            *s++ = castle_letters[bit];
+    }
+    if (s == castle_start)
+        *s++ = '-';
+
+    // Only written if a pawn stands next to the one that just moved two squares
+    *s++ = ' ';
+    const int pawn = board->en_passant_pos;
+    const uint8_t mover = opponent_of(board->current_player);
+    bool can_take = false;
+    if (pawn && board->indices[pawn] == (PIECE_PAWN | mover)) {
+        for (int side = -1; side <= 1; side += 2) {
+            if (!((pawn + side) & 0x88) && board->indices[pawn + side] == (PIECE_PAWN | board->current_player))
+                can_take = true;
+        }
+    }
+    if (can_take) {
+        format_square(pawn + (mover == PIECE_WHITE ? 16 : -16), s);
+        s += 2;
+    }
+    else
+        *s++ = '-';
+
+    if (with_move_numbers)
+        s += sprintf(s, " 0 %u", board->move_count / 2 + 1);
+    *s = 0;
+    return (uint32_t)(s - out);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "foundation/basic.h"
+#include "components.h"
+#include "rules.h"
+
+enum {
+    // Longest FEN written by `format_fen`, including the terminator
+    MAX_FEN_LENGTH = 96,
+};
+
+// Fills the rules state of `board` from the first four FEN fields, plus the
+// move number if present. Castling rights without the king and rook in
+// place are dropped, as is an en passant square without a pawn to take.
+bool parse_fen(const char *fen, size_t length, board_component_t *board);
+
+// Writes the position as FEN, or only its first four fields for EPD when
+// `with_move_numbers` is false. Returns the length. Castling rights and the
+// en passant square are only written while they can still be used.
+uint32_t format_fen(const board_component_t *board, char *out, bool with_move_numbers);
+
+// Rules state of a new game, without touching the rest of `board`
+void set_start_position(board_component_t *board);
+
+// Square of a coordinate like "e4", -1 if invalid. Files are mirrored on
+// the board, a1 is at x 7 of the last row.
+int parse_square(const char *s);
+// Writes the two character coordinate of `square`, without a terminator
+void format_square(int square, char *out);
+
+// Next space separated field, also used for lists of UCI moves. Returns
+// false at the end.
+bool next_fen_field(const char **p, const char *end, const char **field, size_t *length);
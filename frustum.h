@@ -0,0 +1,38 @@
+#pragma once
+#include "foundation/basic.h"
+
+// Planes point inwards: a point p is inside when dot(plane.xyz, p) + plane.w >= 0
+typedef struct frustum_t {
+    vec4_t planes[6];
+} frustum_t;
+
+// Extracts the planes of a view projection matrix `m`, row major with
+// clip = m * world (Gribb & Hartmann). Clip depth is assumed to be 0..w.
+static inline frustum_t frustum_from_matrix(const float m[16])
+{
+    const float *r0 = m, *r1 = m + 4, *r2 = m + 8, *r3 = m + 12;
+    frustum_t f = { {
+        { r3[0] + r0[0], r3[1] + r0[1], r3[2] + r0[2], r3[3] + r0[3] },
+        { r3[0] - r0[0], r3[1] - r0[1], r3[2] - r0[2], r3[3] - r0[3] },
+        { r3[0] + r1[0], r3[1] + r1[1], r3[2] + r1[2], r3[3] + r1[3] },
+        { r3[0] - r1[0], r3[1] - r1[1], r3[2] - r1[2], r3[3] - r1[3] },
+        { r2[0], r2[1], r2[2], r2[3] },
+        { r3[0] - r2[0], r3[1] - r2[1], r3[2] - r2[2], r3[3] - r2[3] },
+    } };
+    return f;
+}
+
+// Conservative; boxes crossing a plane count as inside
+static inline bool frustum_overlaps_box(const frustum_t *f, vec3_t bb_min, vec3_t bb_max)
+{
+    for (int i = 0; i < 6; ++i) {
+        const vec4_t p = f->planes[i];
+        // Corner furthest along the plane normal
+        const float x = p.x >= 0 ? bb_max.x : bb_min.x;
+        const float y = p.y >= 0 ? bb_max.y : bb_min.y;
+        const float z = p.z >= 0 ? bb_max.z : bb_min.z;
+        if (p.x * x + p.y * y + p.z * z + p.w < 0)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,125 @@
+#include "hierarchy.h"
+#include "entity.h"
+
+enum {
+    // Guards against parent cycles
+    MAX_HIERARCHY_DEPTH = 16,
+};
+
+static inline vec4_t multiply_rotations(vec4_t a, vec4_t b)
+{
+    return (vec4_t) {
+        a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+        a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+        a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+    };
+}
+
+static inline vec3_t rotate_position(vec4_t q, vec3_t v)
+{
+    // v + 2w (q x v) + 2 q x (q x v)
+    const vec3_t t = {
+        2.f * (q.y * v.z - q.z * v.y),
+        2.f * (q.z * v.x - q.x * v.z),
+        2.f * (q.x * v.y - q.y * v.x),
+    };
+    return (vec3_t) {
+        v.x + q.w * t.x + (q.y * t.z - q.z * t.y),
+        v.y + q.w * t.y + (q.z * t.x - q.x * t.z),
+        v.z + q.w * t.z + (q.x * t.y - q.y * t.x),
+    };
+}
+
+static transform_t compose_transforms(const transform_t *parent, const transform_t *local)
+{
+    const vec3_t scaled = { local->pos.x * parent->scl.x, local->pos.y * parent->scl.y, local->pos.z * parent->scl.z };
+    return (transform_t) {
+        .pos = vec3_add(parent->pos, rotate_position(parent->rot, scaled)),
+        .rot = multiply_rotations(parent->rot, local->rot),
+        .scl = { local->scl.x * parent->scl.x, local->scl.y * parent->scl.y, local->scl.z * parent->scl.z },
+    };
+}
+
+hierarchy_component_t *attach_transform(entity_ctx_o *ctx, entity_t e, entity_t parent, const transform_t *local)
+{
+    if (!has_component(ctx, e, transform_id))
+        add_component(ctx, e, transform_id);
+
+    hierarchy_component_t *h = has_component(ctx, e, hierarchy_id) ? get_component(ctx, e, hierarchy_id) : add_component(ctx, e, hierarchy_id);
+    h->parent = parent;
+    h->local = *local;
+    h->dirty = true;
+    return h;
+}
+
+void reset_dirty_transforms(dirty_transforms_t *dirty)
+{
+    dirty->count = 0;
+    ++dirty->frame;
+}
+
+void free_dirty_transforms(dirty_transforms_t *dirty)
+{
+    free(dirty->entities);
+    *dirty = (dirty_transforms_t) { 0 };
+}
+
+static void list_dirty_transform(dirty_transforms_t *dirty, entity_t e, hierarchy_component_t *h)
+{
+    // Stored plus one so that zero initialized components are never listed
+    if (h->listed_frame == dirty->frame + 1)
+        return;
+
+    if (dirty->count == dirty->capacity) {
+        const uint32_t capacity = dirty->capacity ? dirty->capacity * 2 : 256;
+        entity_t *entities = realloc(dirty->entities, capacity * sizeof(entity_t));
+        if (!entities)
+            return;
+        dirty->entities = entities;
+        dirty->capacity = capacity;
+    }
+
+    dirty->entities[dirty->count++] = e;
+    h->listed_frame = dirty->frame + 1;
+}
+
+static void update_world_transform(entity_ctx_o *ctx, entity_t e, hierarchy_component_t *h, dirty_transforms_t *dirty, uint32_t depth)
+{
+    // Parents first, so a moved board is rebuilt before its pieces
+    hierarchy_component_t *parent = 0;
+    if (h->parent.id != NO_PARENT.id && depth < MAX_HIERARCHY_DEPTH && is_entity_alive(ctx, h->parent) && has_component(ctx, h->parent, hierarchy_id)) {
+        parent = get_component(ctx, h->parent, hierarchy_id);
+        update_world_transform(ctx, h->parent, parent, dirty, depth + 1);
+    }
+
+    const uint32_t parent_version = parent ? parent->version : 0;
+    if (!h->dirty && h->parent_version == parent_version)
+        return;
+
+    transform_t *world = get_component(ctx, e, transform_id);
+    if (parent)
+        *world = compose_transforms(get_component(ctx, h->parent, transform_id), &h->local);
+    else
+        *world = h->local;
+
+    h->dirty = false;
+    h->parent_version = parent_version;
+    ++h->version;
+
+    if (dirty)
+        list_dirty_transform(dirty, e, h);
+}
+
+void update_transforms(entity_ctx_o *ctx, dirty_transforms_t *dirty)
+{
+    hierarchy_component_t *hierarchies = component_data(ctx, hierarchy_id);
+    const uint64_t mask = (1ULL << hierarchy_id | 1ULL << transform_id);
+
+    entity_t e;
+    uint32_t i = 0;
+    while (find_next_component(ctx, hierarchy_id, mask, &i, &e)) {
+        update_world_transform(ctx, e, &hierarchies[i], dirty, 0);
+        ++i;
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "foundation/basic.h"
+#include "entity_type.h"
+#include "components.h"
+
+struct entity_ctx_o;
+
+// Parents the transform of `e` to `parent`, or makes `e` a root when
+// `parent` is `NO_PARENT`. The world transform is written to the entity's
+// `transform_t` by `update_transforms`.
+hierarchy_component_t *attach_transform(struct entity_ctx_o *ctx, entity_t e, entity_t parent, const transform_t *local);
+
+static inline void set_local_position(hierarchy_component_t *h, vec3_t pos)
+{
+    h->local.pos = pos;
+    h->dirty = true;
+}
+
+// Entities whose world transform changed since the last reset, each listed
+// once. Lets a render sync upload only what moved. Zero initialized is empty.
+typedef struct dirty_transforms_t {
+    entity_t *entities;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t frame;
+} dirty_transforms_t;
+
+// Empties the list, call after the changes have been consumed
+void reset_dirty_transforms(dirty_transforms_t *dirty);
+void free_dirty_transforms(dirty_transforms_t *dirty);
+
+// Recomputes world transforms of dirty entities and everything below them
+// and appends them to `dirty`, which may be NULL. Call once per frame after
+// gameplay systems have moved things.
+void update_transforms(struct entity_ctx_o *ctx, dirty_transforms_t *dirty);
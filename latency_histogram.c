@@ -0,0 +1,52 @@
+#include "latency_histogram.h"
+
+static uint32_t bucket_of(uint64_t us)
+{
+    if (us < LATENCY_SUB_BUCKETS)
+        return (uint32_t)us;
+
+    const uint32_t msb = 63 - (uint32_t)__builtin_clzll(us);
+    const uint32_t sub = (uint32_t)(us >> (msb - 3)) & (LATENCY_SUB_BUCKETS - 1);
+    const uint32_t bucket = (msb - 2) * LATENCY_SUB_BUCKETS + sub;
+    return bucket < LATENCY_HISTOGRAM_BUCKETS ? bucket : LATENCY_HISTOGRAM_BUCKETS - 1;
+}
+
+// First microsecond value past the bucket
+static uint64_t bucket_end_us(uint32_t bucket)
+{
+    if (bucket < LATENCY_SUB_BUCKETS)
+        return bucket + 1;
+
+    const uint32_t msb = bucket / LATENCY_SUB_BUCKETS + 2;
+    const uint64_t sub = bucket % LATENCY_SUB_BUCKETS;
+    return (LATENCY_SUB_BUCKETS + sub + 1) << (msb - 3);
+}
+
+void record_latency(latency_histogram_t *h, uint64_t ns)
+{
+    ++h->counts[bucket_of(ns / 1000)];
+    ++h->num_samples;
+    h->total_ns += ns;
+    if (ns > h->max_ns)
+        h->max_ns = ns;
+}
+
+uint64_t latency_percentile(const latency_histogram_t *h, double percentile)
+{
+    if (h->num_samples == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)h->num_samples + 0.5);
+    if (rank < 1)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < LATENCY_HISTOGRAM_BUCKETS; ++b) {
+        seen += h->counts[b];
+        if (seen >= rank) {
+            const uint64_t end_ns = bucket_end_us(b) * 1000;
+            return end_ns < h->max_ns ? end_ns : h->max_ns;
+        }
+    }
+    return h->max_ns;
+}
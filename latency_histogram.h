@@ -0,0 +1,24 @@
+#pragma once
+#include "foundation/basic.h"
+
+enum {
+    // Microsecond buckets, eight per power of two so any value is off by
+    // at most 12.5%. The last bucket also holds everything above a minute.
+    LATENCY_SUB_BUCKETS = 8,
+    LATENCY_HISTOGRAM_BUCKETS = 192,
+};
+
+// Fixed size histogram, recording never allocates. A zero initialized
+// histogram is empty.
+typedef struct latency_histogram_t {
+    uint32_t counts[LATENCY_HISTOGRAM_BUCKETS];
+    uint64_t num_samples;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} latency_histogram_t;
+
+void record_latency(latency_histogram_t *h, uint64_t ns);
+
+// Upper bound of the bucket holding the `percentile` (0 to 100) sample,
+// never more than the largest recorded value. Zero if empty.
+uint64_t latency_percentile(const latency_histogram_t *h, double percentile);
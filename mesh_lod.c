@@ -0,0 +1,116 @@
+#include "mesh_lod.h"
+#include "arena.h"
+#include "entity.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESH_LOD_SSE 1
+#else
+#define MESH_LOD_SSE 0
+#endif
+
+// Positions gathered as separate x, y and z arrays, rebuilt every call
+static arena_t lod_arena;
+
+// Level of each position: the number of thresholds its squared distance reaches
+static void compute_levels(const float *xs, const float *ys, const float *zs, uint32_t n, vec3_t camera,
+    const float *thresholds_sq, uint32_t num_thresholds, uint8_t *levels)
+{
+    uint32_t i = 0;
+
+#if MESH_LOD_SSE
+    const __m128 cx = _mm_set1_ps(camera.x);
+    const __m128 cy = _mm_set1_ps(camera.y);
+    const __m128 cz = _mm_set1_ps(camera.z);
+    for (; i + 4 <= n; i += 4) {
+        const __m128 dx = _mm_sub_ps(_mm_loadu_ps(xs + i), cx);
+        const __m128 dy = _mm_sub_ps(_mm_loadu_ps(ys + i), cy);
+        const __m128 dz = _mm_sub_ps(_mm_loadu_ps(zs + i), cz);
+        const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+        // Compare masks are all ones (-1) where reached
+        __m128i level = _mm_setzero_si128();
+        for (uint32_t t = 0; t < num_thresholds; ++t)
+            level = _mm_sub_epi32(level, _mm_castps_si128(_mm_cmpge_ps(d2, _mm_set1_ps(thresholds_sq[t]))));
+
+        int32_t out[4];
+        _mm_storeu_si128((__m128i *)out, level);
+        levels[i + 0] = (uint8_t)out[0];
+        levels[i + 1] = (uint8_t)out[1];
+        levels[i + 2] = (uint8_t)out[2];
+        levels[i + 3] = (uint8_t)out[3];
+    }
+#endif
+
+    for (; i < n; ++i) {
+        const float dx = xs[i] - camera.x;
+        const float dy = ys[i] - camera.y;
+        const float dz = zs[i] - camera.z;
+        const float d2 = dx * dx + dy * dy + dz * dz;
+        uint8_t level = 0;
+        for (uint32_t t = 0; t < num_thresholds; ++t)
+            level += d2 >= thresholds_sq[t];
+        levels[i] = level;
+    }
+}
+
+void select_mesh_lods(entity_ctx_o *ctx, vec3_t camera_pos, const mesh_lod_params_t *params, mesh_lod_stats_t *stats)
+{
+    if (stats)
+        *stats = (mesh_lod_stats_t) { 0 };
+
+    float thresholds_sq[MAX_MESH_LODS - 1];
+    for (uint32_t t = 0; t < MAX_MESH_LODS - 1; ++t)
+        thresholds_sq[t] = params->distances[t] * params->distances[t];
+
+    mesh_component_t *meshes = component_data(ctx, mesh_id);
+    const uint64_t mask = (1ULL << mesh_id | 1ULL << transform_id);
+
+    uint32_t n = 0;
+    {
+        entity_t e;
+        uint32_t i = 0;
+        while (find_next_component(ctx, mesh_id, mask, &i, &e)) {
+            n += meshes[i].num_lods > 0;
+            ++i;
+        }
+    }
+    if (n == 0)
+        return;
+
+    arena_reset(&lod_arena);
+    float *xs = arena_push_array(&lod_arena, float, n);
+    float *ys = arena_push_array(&lod_arena, float, n);
+    float *zs = arena_push_array(&lod_arena, float, n);
+    uint32_t *components = arena_push_array(&lod_arena, uint32_t, n);
+    uint8_t *levels = arena_push_array(&lod_arena, uint8_t, n);
+
+    uint32_t k = 0;
+    entity_t e;
+    uint32_t i = 0;
+    while (find_next_component(ctx, mesh_id, mask, &i, &e)) {
+        if (meshes[i].num_lods > 0) {
+            const transform_t *tm = get_component(ctx, e, transform_id);
+            xs[k] = tm->pos.x;
+            ys[k] = tm->pos.y;
+            zs[k] = tm->pos.z;
+            components[k] = i;
+            ++k;
+        }
+        ++i;
+    }
+
+    compute_levels(xs, ys, zs, n, camera_pos, thresholds_sq, MAX_MESH_LODS - 1, levels);
+
+    for (k = 0; k < n; ++k) {
+        mesh_component_t *mesh = &meshes[components[k]];
+        mesh->lod = levels[k] < mesh->num_lods ? levels[k] : (uint8_t)mesh->num_lods;
+        if (stats) {
+            ++stats->instances_per_level[mesh->lod];
+            stats->triangles_submitted += get_lod_triangles(mesh);
+            stats->triangles_full_detail += mesh->lod_triangles[0];
+        }
+    }
+    if (stats)
+        stats->num_meshes = n;
+}
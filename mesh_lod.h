@@ -0,0 +1,23 @@
+#pragma once
+#include "foundation/basic.h"
+#include "components.h"
+
+struct entity_ctx_o;
+
+typedef struct mesh_lod_params_t {
+    // Camera distance where each reduced level starts, ascending
+    float distances[MAX_MESH_LODS - 1];
+} mesh_lod_params_t;
+
+typedef struct mesh_lod_stats_t {
+    // Mesh components with reduced levels
+    uint32_t num_meshes;
+    uint32_t instances_per_level[MAX_MESH_LODS];
+    // Triangles of these meshes at their selected level, and at full detail
+    uint64_t triangles_submitted;
+    uint64_t triangles_full_detail;
+} mesh_lod_stats_t;
+
+// Picks `mesh_component_t.lod` for every mesh with reduced levels from its
+// distance to `camera_pos`. Call once per frame after `update_transforms`.
+void select_mesh_lods(struct entity_ctx_o *ctx, vec3_t camera_pos, const mesh_lod_params_t *params, mesh_lod_stats_t *stats);
@@ -0,0 +1,17 @@
+#pragma once
+#include "foundation/basic.h"
+#include <time.h>
+
+// Monotonic high-resolution time in nanoseconds; unaffected by wall clock
+// changes and frame delta hitches.
+static inline uint64_t time_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline double time_ns_to_ms(uint64_t ns)
+{
+    return (double)ns / 1000000.0;
+}
@@ -0,0 +1,69 @@
+#include "move_events.h"
+
+typedef struct world_events_t {
+    struct entity_ctx_o *ctx;
+    move_event_ring_t *ring;
+} world_events_t;
+
+// Rings are looked up by world, there are only ever a handful
+static struct {
+    world_events_t *worlds;
+    uint32_t num_worlds;
+    uint32_t capacity;
+} events;
+
+move_event_ring_t *get_move_events(struct entity_ctx_o *ctx)
+{
+    for (uint32_t i = 0; i < events.num_worlds; ++i) {
+        if (events.worlds[i].ctx == ctx)
+            return events.worlds[i].ring;
+    }
+
+    if (events.num_worlds == events.capacity) {
+        const uint32_t capacity = events.capacity ? events.capacity * 2 : 16;
+        world_events_t *worlds = realloc(events.worlds, capacity * sizeof(world_events_t));
+        if (!worlds)
+            return 0;
+        events.worlds = worlds;
+        events.capacity = capacity;
+    }
+
+    move_event_ring_t *ring = calloc(1, sizeof(move_event_ring_t));
+    if (ring)
+        events.worlds[events.num_worlds++] = (world_events_t) { .ctx = ctx, .ring = ring };
+    return ring;
+}
+
+void release_move_events(struct entity_ctx_o *ctx)
+{
+    for (uint32_t i = 0; i < events.num_worlds; ++i) {
+        if (events.worlds[i].ctx == ctx) {
+            free(events.worlds[i].ring);
+            events.worlds[i] = events.worlds[--events.num_worlds];
+            return;
+        }
+    }
+}
+
+void push_move_event(move_event_ring_t *ring, const move_event_t *event)
+{
+    ring->events[ring->head & (MOVE_EVENT_CAPACITY - 1)] = *event;
+    ++ring->head;
+}
+
+bool next_move_event(const move_event_ring_t *ring, move_event_cursor_t *cursor, move_event_t *event)
+{
+    if (cursor->next >= ring->head)
+        return false;
+
+    // Fell behind by more than a full ring; skip what was overwritten
+    const uint64_t oldest = ring->head > MOVE_EVENT_CAPACITY ? ring->head - MOVE_EVENT_CAPACITY : 0;
+    if (cursor->next < oldest) {
+        cursor->dropped += oldest - cursor->next;
+        cursor->next = oldest;
+    }
+
+    *event = ring->events[cursor->next & (MOVE_EVENT_CAPACITY - 1)];
+    ++cursor->next;
+    return true;
+}
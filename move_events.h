@@ -0,0 +1,70 @@
+#pragma once
+#include "foundation/basic.h"
+#include "entity_type.h"
+
+struct entity_ctx_o;
+
+enum {
+    MOVE_EVENT_MOVE,
+    MOVE_EVENT_CAPTURE,
+    MOVE_EVENT_CASTLE,
+    MOVE_EVENT_EN_PASSANT,
+    // Follows the move event of the promoted pawn
+    MOVE_EVENT_PROMOTION,
+    MOVE_EVENT_GAME_END,
+    // Position replaced without a move, see `set_board_state`
+    MOVE_EVENT_RESET,
+};
+
+enum {
+    // Events kept per world, must be a power of two
+    MOVE_EVENT_CAPACITY = 1024,
+};
+
+typedef struct move_event_t {
+    uint8_t type;
+    entity_t board;
+    // Piece mask of the moved piece, the pawn for promotions
+    uint8_t piece;
+    uint8_t from;
+    uint8_t to;
+    // Captured piece and where it stood, `rook_pos` holds the castling rook
+    uint8_t capture;
+    uint8_t capture_pos;
+    uint8_t rook_pos;
+    uint8_t promotion;
+    // Board state after the move, see `STATE_PLAYING`
+    uint8_t game_state;
+    uint32_t move_count;
+} move_event_t;
+
+typedef struct move_event_ring_t {
+    move_event_t events[MOVE_EVENT_CAPACITY];
+    // Number of events pushed so far, the next one goes to `head % MOVE_EVENT_CAPACITY`
+    uint64_t head;
+} move_event_ring_t;
+
+// Read position of one consumer. A zero initialized cursor starts at the
+// oldest event still in the ring.
+typedef struct move_event_cursor_t {
+    uint64_t next;
+    // Events overwritten before this consumer read them
+    uint64_t dropped;
+} move_event_cursor_t;
+
+// Ring of the world `ctx`, created on first use. Null if the ring can't be
+// allocated.
+move_event_ring_t *get_move_events(struct entity_ctx_o *ctx);
+// Frees the ring of `ctx`, see `release_world`
+void release_move_events(struct entity_ctx_o *ctx);
+
+void push_move_event(move_event_ring_t *ring, const move_event_t *event);
+
+// Copies the next unread event to `event`. Returns false once the consumer has caught up.
+bool next_move_event(const move_event_ring_t *ring, move_event_cursor_t *cursor, move_event_t *event);
+
+// Skips to the newest event, for consumers that only care about what happens from now on
+static inline void skip_move_events(const move_event_ring_t *ring, move_event_cursor_t *cursor)
+{
+    cursor->next = ring->head;
+}
@@ -0,0 +1,96 @@
+#pragma once
+// Generated by tools/gen_move_tables.c, do not edit.
+
+enum {
+    ATTACK_WHITE_PAWN = 0x01,
+    ATTACK_BLACK_PAWN = 0x02,
+    ATTACK_KNIGHT = 0x04,
+    ATTACK_KING = 0x08,
+    ATTACK_DIAGONAL = 0x10,
+    ATTACK_STRAIGHT = 0x20,
+    // Difference `to - from` of two squares is looked up at `diff + DIFF_OFFSET`
+    DIFF_OFFSET = 119,
+};
+
+static const int8_t knight_offsets[8] = {
+    -33, -31, -18, -14, 14, 18, 31, 33,
+};
+
+static const int8_t king_offsets[8] = {
+    -17, -16, -15, -1, 1, 15, 16, 17,
+};
+
+static const int8_t diagonal_steps[4] = {
+    -17, -15, 15, 17,
+};
+
+static const int8_t straight_steps[4] = {
+    -16, -1, 1, 16,
+};
+
+// Which moves can reach a square difference, see `ATTACK_KNIGHT`
+static const uint8_t attack_by_diff[240] = {
+    16, 0, 0, 0, 0, 0, 0, 32, 0, 0, 0, 0, 0, 0, 16, 0,
+    0, 16, 0, 0, 0, 0, 0, 32, 0, 0, 0, 0, 0, 16, 0, 0,
+    0, 0, 16, 0, 0, 0, 0, 32, 0, 0, 0, 0, 16, 0, 0, 0,
+    0, 0, 0, 16, 0, 0, 0, 32, 0, 0, 0, 16, 0, 0, 0, 0,
+    0, 0, 0, 0, 16, 0, 0, 32, 0, 0, 16, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 16, 4, 32, 4, 16, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 4, 25, 40, 25, 4, 0, 0, 0, 0, 0, 0,
+    32, 32, 32, 32, 32, 32, 40, 0, 40, 32, 32, 32, 32, 32, 32, 0,
+    0, 0, 0, 0, 0, 4, 26, 40, 26, 4, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 16, 4, 32, 4, 16, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 16, 0, 0, 32, 0, 0, 16, 0, 0, 0, 0, 0,
+    0, 0, 0, 16, 0, 0, 0, 32, 0, 0, 0, 16, 0, 0, 0, 0,
+    0, 0, 16, 0, 0, 0, 0, 32, 0, 0, 0, 0, 16, 0, 0, 0,
+    0, 16, 0, 0, 0, 0, 0, 32, 0, 0, 0, 0, 0, 16, 0, 0,
+    16, 0, 0, 0, 0, 0, 0, 32, 0, 0, 0, 0, 0, 0, 16, 0,
+};
+
+// Sliding step along a square difference, zero if not on a line
+static const int8_t direction_by_diff[240] = {
+    -17, 0, 0, 0, 0, 0, 0, -16, 0, 0, 0, 0, 0, 0, -15, 0,
+    0, -17, 0, 0, 0, 0, 0, -16, 0, 0, 0, 0, 0, -15, 0, 0,
+    0, 0, -17, 0, 0, 0, 0, -16, 0, 0, 0, 0, -15, 0, 0, 0,
+    0, 0, 0, -17, 0, 0, 0, -16, 0, 0, 0, -15, 0, 0, 0, 0,
+    0, 0, 0, 0, -17, 0, 0, -16, 0, 0, -15, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, -17, 0, -16, 0, -15, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, -17, -16, -15, 0, 0, 0, 0, 0, 0, 0,
+    -1, -1, -1, -1, -1, -1, -1, 0, 1, 1, 1, 1, 1, 1, 1, 0,
+    0, 0, 0, 0, 0, 0, 15, 16, 17, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 15, 0, 16, 0, 17, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 15, 0, 0, 16, 0, 0, 17, 0, 0, 0, 0, 0,
+    0, 0, 0, 15, 0, 0, 0, 16, 0, 0, 0, 17, 0, 0, 0, 0,
+    0, 0, 15, 0, 0, 0, 0, 16, 0, 0, 0, 0, 17, 0, 0, 0,
+    0, 15, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0, 0, 17, 0, 0,
+    15, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0, 0, 0, 17, 0,
+};
+
+// Attack bits of each piece mask
+static const uint8_t piece_attacks[16] = {
+    0, 1, 4, 8, 0, 16, 32, 48,
+    0, 2, 4, 8, 0, 16, 32, 48,
+};
+
+// Castling, indexed by castle bit
+static const uint8_t castle_king_from[4] = {
+    115, 115, 3, 3,
+};
+
+static const uint8_t castle_king_to[4] = {
+    117, 113, 5, 1,
+};
+
+static const uint8_t castle_rook_from[4] = {
+    119, 112, 7, 0,
+};
+
+static const uint8_t castle_rook_to[4] = {
+    116, 114, 4, 2,
+};
+
+// Columns between king and rook that must be empty
+static const uint8_t castle_path_mask[4] = {
+    112, 6, 112, 6,
+};
+
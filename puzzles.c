@@ -0,0 +1,160 @@
+#include "puzzles.h"
+#include "rules_api.h"
+#include "fen.h"
+#include "foundation/log.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const void *map_file(const char *path, size_t *size)
+{
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        data = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps the file open
+    close(fd);
+    if (data == MAP_FAILED)
+        return 0;
+
+    *size = (size_t)st.st_size;
+    return data;
+}
+
+puzzle_set_t *open_puzzle_set(const char *csv_path, const char *index_path)
+{
+    puzzle_set_t *set = calloc(1, sizeof(puzzle_set_t));
+    if (!set)
+        return 0;
+
+    set->csv = map_file(csv_path, &set->csv_size);
+    set->header = map_file(index_path, &set->index_size);
+    if (!set->csv || !set->header) {
+        log_print(LOG_ERROR, "Failed to map puzzles '%s' with index '%s'", csv_path, index_path);
+        close_puzzle_set(set);
+        return 0;
+    }
+
+    const puzzle_index_header_t *h = set->header;
+    if (set->index_size < sizeof(*h) || h->magic != PUZZLE_INDEX_MAGIC || h->version != PUZZLE_INDEX_VERSION
+        || h->num_puzzles > UINT32_MAX || (set->index_size - sizeof(*h)) / sizeof(puzzle_index_entry_t) < h->num_puzzles) {
+        log_print(LOG_ERROR, "Invalid puzzle index '%s'", index_path);
+        close_puzzle_set(set);
+        return 0;
+    }
+    if (h->csv_size != set->csv_size) {
+        log_print(LOG_ERROR, "Puzzle index '%s' was built for another version of '%s'", index_path, csv_path);
+        close_puzzle_set(set);
+        return 0;
+    }
+
+    set->entries = (const puzzle_index_entry_t *)(h + 1);
+    set->num_puzzles = (uint32_t)h->num_puzzles;
+    // Puzzles are picked all over the file, read ahead would be wasted
+    madvise((void *)set->csv, set->csv_size, MADV_RANDOM);
+    return set;
+}
+
+void close_puzzle_set(puzzle_set_t *set)
+{
+    if (!set)
+        return;
+    if (set->csv)
+        munmap((void *)set->csv, set->csv_size);
+    if (set->header)
+        munmap((void *)set->header, set->index_size);
+    free(set);
+}
+
+uint32_t find_puzzle_by_rating(const puzzle_set_t *set, uint32_t rating)
+{
+    uint32_t lo = 0;
+    uint32_t hi = set->num_puzzles;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (set->entries[mid].rating < rating)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static bool find_column(const char *line, const char *end, uint32_t column, const char **field, size_t *length)
+{
+    const char *s = line;
+    for (uint32_t i = 0; i < column; ++i) {
+        s = memchr(s, ',', (size_t)(end - s));
+        if (!s)
+            return false;
+        ++s;
+    }
+    const char *e = memchr(s, ',', (size_t)(end - s));
+    if (!e)
+        e = end;
+    // CRLF line endings
+    while (e > s && (e[-1] == '\r' || e[-1] == '\n'))
+        --e;
+    *field = s;
+    *length = (size_t)(e - s);
+    return true;
+}
+
+bool read_puzzle(const puzzle_set_t *set, uint32_t index, puzzle_t *puzzle)
+{
+    if (index >= set->num_puzzles)
+        return false;
+
+    const puzzle_index_entry_t *entry = &set->entries[index];
+    if (entry->offset > set->csv_size || entry->length > set->csv_size - entry->offset) {
+        log_print(LOG_WARN, "Puzzle %u lies outside the puzzle file", index);
+        return false;
+    }
+
+    const char *line = set->csv + entry->offset;
+    const char *end = line + entry->length;
+    const char *fen;
+    const char *moves;
+    size_t fen_length;
+    size_t moves_length;
+    if (!find_column(line, end, set->header->fen_column, &fen, &fen_length)
+        || !find_column(line, end, set->header->moves_column, &moves, &moves_length)) {
+        log_print(LOG_WARN, "Puzzle %u is missing columns", index);
+        return false;
+    }
+
+    memset(puzzle, 0, sizeof(*puzzle));
+    puzzle->index = index;
+    puzzle->rating = entry->rating;
+    puzzle->board.selected_piece.id = UINT64_MAX;
+    if (!parse_fen(fen, fen_length, &puzzle->board)) {
+        log_print(LOG_WARN, "Puzzle %u has an invalid FEN '%.*s'", index, (int)fen_length, fen);
+        return false;
+    }
+
+    // Replayed to catch moves these rules don't allow, e.g. underpromotions
+    board_component_t board = puzzle->board;
+    const char *p = moves;
+    const char *field;
+    size_t n;
+    while (next_fen_field(&p, moves + moves_length, &field, &n)) {
+        const int from = n >= 4 ? parse_square(field) : -1;
+        const int to = n >= 4 ? parse_square(field + 2) : -1;
+        const bool queen_or_none = n == 4 || (n == 5 && field[4] == 'q');
+        if (from < 0 || to < 0 || !queen_or_none || puzzle->num_moves == PUZZLE_MAX_MOVES
+            || !rules_api->is_legal_move(&board, from, to) || rules_api->is_checked_after_move(&board, from, to)) {
+            log_print(LOG_WARN, "Puzzle %u has an unplayable move '%.*s'", index, (int)n, field);
+            return false;
+        }
+        rules_api->perform_move(&board, from, to);
+        puzzle->moves[puzzle->num_moves++] = (move_t) { .from = (uint8_t)from, .to = (uint8_t)to };
+    }
+
+    // The opponent's move and at least one to solve
+    return puzzle->num_moves >= 2;
+}
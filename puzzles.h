@@ -0,0 +1,70 @@
+#pragma once
+#include "foundation/basic.h"
+#include "components.h"
+#include "rules.h"
+
+// Puzzles come from a CSV with one puzzle per line, e.g. the Lichess puzzle
+// database: a FEN, the solution as UCI moves separated by spaces, and a
+// rating. The first solution move is the opponent's move leading into the
+// puzzle. tools/index_puzzles.c writes the index, sorted by rating:
+//
+//   header:  puzzle_index_header_t
+//   entries: puzzle_index_entry_t[num_puzzles]
+//
+// Both files are mapped, a puzzle only touches the pages of its own line.
+
+enum {
+    PUZZLE_INDEX_MAGIC = 0x58495a50, // "PZIX"
+    PUZZLE_INDEX_VERSION = 1,
+};
+
+typedef struct puzzle_index_header_t {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t num_puzzles;
+    // Size of the indexed CSV, a rewritten CSV needs a new index
+    uint64_t csv_size;
+    // Zero based CSV columns
+    uint32_t fen_column;
+    uint32_t moves_column;
+    uint32_t rating_column;
+    uint32_t padding;
+} puzzle_index_header_t;
+
+typedef struct puzzle_index_entry_t {
+    // Start of the line in the CSV
+    uint64_t offset;
+    uint32_t length;
+    uint16_t rating;
+    uint16_t num_moves;
+} puzzle_index_entry_t;
+
+typedef struct puzzle_set_t {
+    const char *csv;
+    size_t csv_size;
+    const puzzle_index_header_t *header;
+    size_t index_size;
+    const puzzle_index_entry_t *entries;
+    uint32_t num_puzzles;
+} puzzle_set_t;
+
+typedef struct puzzle_t {
+    uint32_t index;
+    uint16_t rating;
+    // Position before the opponent's first move
+    board_component_t board;
+    uint32_t num_moves;
+    move_t moves[PUZZLE_MAX_MOVES];
+} puzzle_t;
+
+// Maps the CSV and its index. Returns null if either can't be mapped or the
+// index wasn't built from this CSV.
+puzzle_set_t *open_puzzle_set(const char *csv_path, const char *index_path);
+void close_puzzle_set(puzzle_set_t *set);
+
+// First puzzle rated at least `rating`, `num_puzzles` if there is none
+uint32_t find_puzzle_by_rating(const puzzle_set_t *set, uint32_t rating);
+
+// Parses puzzle `index` and replays its solution through `rules_api`.
+// Returns false if the line is malformed or a solution move is illegal.
+bool read_puzzle(const puzzle_set_t *set, uint32_t index, puzzle_t *puzzle);
@@ -0,0 +1,294 @@
+#include "random_positions.h"
+#include "rules_api.h"
+#include "fen.h"
+#include "monotonic_clock.h"
+#include <pthread.h>
+
+enum {
+    // Positions per thread and batch, batches are written in order
+    POSITIONS_PER_TASK = 4096,
+    MAX_POSITION_THREADS = 64,
+    // EPD position plus opcodes
+    MAX_EPD_LINE = MAX_FEN_LENGTH + 64,
+    // Practically never reached, random play rarely ends a game
+    MAX_PLAYOUT_ATTEMPTS = 64,
+};
+
+static inline uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static inline uint32_t random_below(uint64_t *rng, uint32_t n)
+{
+    return (uint32_t)((splitmix64(rng) >> 32) * n >> 32);
+}
+
+static int find_king(const board_component_t *board, uint8_t player)
+{
+    for (int pos = 0; pos < 128; ++pos) {
+        if (board->indices[pos] == (PIECE_KING | player))
+            return pos;
+    }
+    return -1;
+}
+
+static inline int step_sign(int d)
+{
+    return (d > 0) - (d < 0);
+}
+
+// True if moving the piece on `from` can't uncover a check on `king`: it
+// isn't on a line with the king, or something else stands between them, or
+// no opponent slider of the line's kind is behind it.
+static bool cannot_be_pinned(const uint8_t *b, int king, int from, uint8_t player)
+{
+    const int dx = (from & 7) - (king & 7);
+    const int dz = (from >> 4) - (king >> 4);
+    if (dx != 0 && dz != 0 && dx != dz && dx != -dz)
+        return true;
+
+    const int step = step_sign(dz) * 16 + step_sign(dx);
+    for (int pos = king + step; pos != from; pos += step) {
+        if (b[pos] != 0)
+            return true;
+    }
+    // Rooks and queens pin along ranks and files, bishops and queens along diagonals
+    const uint8_t slider = dx == 0 || dz == 0 ? 0x2 : 0x1;
+    for (int pos = from + step; !(pos & 0x88); pos += step) {
+        if (b[pos] == 0)
+            continue;
+        return (b[pos] & MASK_COLOR) == player || (b[pos] & MASK_SLIDE) == 0 || (b[pos] & slider) == 0;
+    }
+    return true;
+}
+
+// Draws pseudo-legal moves until a legal one comes up. As uniform over the
+// legal moves as `generate_legal_moves`, but only tries moves until one fits.
+// `king` is the square of the mover's king. Out of check, moves of pieces
+// that can't be pinned are legal without playing them, the king and en
+// passant always take the full check.
+static bool pick_legal_move(board_component_t *board, uint64_t *rng, int king, move_t *move)
+{
+    move_t moves[MAX_MOVES];
+    const uint8_t player = board->current_player;
+    const uint8_t opponent = opponent_of(player);
+    const bool in_check = rules_api->is_square_attacked(board, king, opponent);
+    uint32_t n = rules_api->generate_moves(board, moves);
+    while (n > 0) {
+        const uint32_t i = random_below(rng, n);
+        const int from = moves[i].from;
+        const int to = moves[i].to;
+        const uint8_t type = board->indices[from] & MASK_TYPE;
+        const bool en_passant = type == PIECE_PAWN && (from & 7) != (to & 7) && board->indices[to] == 0;
+        bool legal;
+        if (!in_check && type != PIECE_KING && !en_passant && cannot_be_pinned(board->indices, king, from, player))
+            legal = true;
+        else {
+            const move_info_t info = rules_api->perform_move(board, from, to);
+            legal = !rules_api->is_square_attacked(board, from == king ? to : king, opponent);
+            rules_api->revert_move(board, from, to, &info);
+        }
+        if (legal) {
+            *move = moves[i];
+            return true;
+        }
+        moves[i] = moves[--n];
+    }
+    return false;
+}
+
+bool random_playout(board_component_t *board, uint64_t *rng, uint32_t num_plies)
+{
+    // Only king moves change these, castling included
+    int kings[2] = { find_king(board, PIECE_WHITE), find_king(board, PIECE_BLACK) };
+    if (kings[0] < 0 || kings[1] < 0)
+        return false;
+    move_t move;
+    for (uint32_t ply = 0; ply < num_plies; ++ply) {
+        int *king = &kings[board->current_player / 8];
+        if (!pick_legal_move(board, rng, *king, &move))
+            return false;
+        if (move.from == *king)
+            *king = move.to;
+        rules_api->perform_move(board, move.from, move.to);
+    }
+    return true;
+}
+
+void random_position(const random_position_params_t *params, uint64_t index, board_component_t *board, random_position_stats_t *stats)
+{
+    // Hashing the index keeps the streams of neighboring positions apart
+    uint64_t index_state = index;
+    uint64_t rng = params->seed ^ splitmix64(&index_state);
+
+    const uint32_t range = params->max_plies > params->min_plies ? params->max_plies - params->min_plies + 1 : 1;
+    const uint32_t num_plies = params->min_plies + random_below(&rng, range);
+    ++stats->num_positions;
+
+    move_t move;
+    for (uint32_t attempt = 0; attempt < MAX_PLAYOUT_ATTEMPTS; ++attempt) {
+        set_start_position(board);
+        if (random_playout(board, &rng, num_plies) && pick_legal_move(board, &rng, find_king(board, board->current_player), &move)) {
+            stats->num_plies += num_plies;
+            return;
+        }
+        ++stats->num_retries;
+    }
+    set_start_position(board);
+}
+
+typedef struct position_task_t {
+    const random_position_params_t *params;
+    uint64_t begin;
+    uint64_t end;
+    // EPD lines of the batch, null when nothing is written
+    char *text;
+    size_t text_size;
+    random_position_stats_t stats;
+} position_task_t;
+
+static void run_position_task(position_task_t *task)
+{
+    board_component_t board = { 0 };
+    char *s = task->text;
+    for (uint64_t i = task->begin; i < task->end; ++i) {
+        random_position(task->params, i, &board, &task->stats);
+        if (!s)
+            continue;
+        s += format_fen(&board, s, false);
+        s += sprintf(s, " fmvn %u; id \"%llu.%llu\";\n", board.move_count / 2 + 1,
+            (unsigned long long)task->params->seed, (unsigned long long)i);
+    }
+    task->text_size = s ? (size_t)(s - task->text) : 0;
+}
+
+// Workers live for the whole call and take one task per batch
+typedef struct position_pool_t {
+    pthread_mutex_t mutex;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint64_t batch;
+    uint32_t num_running;
+    bool quit;
+} position_pool_t;
+
+typedef struct position_worker_t {
+    position_pool_t *pool;
+    position_task_t *task;
+} position_worker_t;
+
+static void *position_thread(void *data)
+{
+    position_worker_t *worker = data;
+    position_pool_t *pool = worker->pool;
+    uint64_t batch = 0;
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (pool->batch == batch && !pool->quit)
+            pthread_cond_wait(&pool->start, &pool->mutex);
+        if (pool->quit)
+            break;
+        batch = pool->batch;
+        pthread_mutex_unlock(&pool->mutex);
+
+        run_position_task(worker->task);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->num_running == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+random_position_stats_t write_random_positions(const random_position_params_t *params, FILE *out)
+{
+    uint32_t num_threads = params->num_threads ? params->num_threads : 1;
+    if (num_threads > MAX_POSITION_THREADS)
+        num_threads = MAX_POSITION_THREADS;
+
+    position_task_t tasks[MAX_POSITION_THREADS] = { 0 };
+    bool out_of_memory = false;
+    for (uint32_t t = 0; t < num_threads; ++t) {
+        tasks[t].params = params;
+        if (out) {
+            tasks[t].text = malloc(POSITIONS_PER_TASK * MAX_EPD_LINE);
+            out_of_memory |= !tasks[t].text;
+        }
+    }
+    if (out_of_memory) {
+        for (uint32_t t = 0; t < num_threads; ++t)
+            free(tasks[t].text);
+        return (random_position_stats_t) { 0 };
+    }
+
+    position_pool_t pool = { 0 };
+    pthread_mutex_init(&pool.mutex, 0);
+    pthread_cond_init(&pool.start, 0);
+    pthread_cond_init(&pool.done, 0);
+    position_worker_t workers[MAX_POSITION_THREADS];
+    pthread_t threads[MAX_POSITION_THREADS];
+    bool started[MAX_POSITION_THREADS] = { 0 };
+    uint32_t num_workers = 0;
+    for (uint32_t t = 1; t < num_threads; ++t) {
+        workers[t] = (position_worker_t) { .pool = &pool, .task = &tasks[t] };
+        started[t] = pthread_create(&threads[t], 0, position_thread, &workers[t]) == 0;
+        num_workers += started[t];
+    }
+
+    const uint64_t start = time_now_ns();
+    const uint64_t num_positions = params->num_positions;
+    for (uint64_t base = 0; base < num_positions; base += (uint64_t)num_threads * POSITIONS_PER_TASK) {
+        for (uint32_t t = 0; t < num_threads; ++t) {
+            const uint64_t begin = base + (uint64_t)t * POSITIONS_PER_TASK;
+            tasks[t].begin = begin < num_positions ? begin : num_positions;
+            tasks[t].end = tasks[t].begin + POSITIONS_PER_TASK < num_positions ? tasks[t].begin + POSITIONS_PER_TASK : num_positions;
+        }
+
+        pthread_mutex_lock(&pool.mutex);
+        ++pool.batch;
+        pool.num_running = num_workers;
+        pthread_cond_broadcast(&pool.start);
+        pthread_mutex_unlock(&pool.mutex);
+
+        // The calling thread takes the first task, and any that didn't get a thread
+        for (uint32_t t = 0; t < num_threads; ++t) {
+            if (!started[t])
+                run_position_task(&tasks[t]);
+        }
+
+        pthread_mutex_lock(&pool.mutex);
+        while (pool.num_running > 0)
+            pthread_cond_wait(&pool.done, &pool.mutex);
+        pthread_mutex_unlock(&pool.mutex);
+
+        for (uint32_t t = 0; out && t < num_threads; ++t)
+            fwrite(tasks[t].text, 1, tasks[t].text_size, out);
+    }
+    const uint64_t elapsed_ns = time_now_ns() - start;
+
+    pthread_mutex_lock(&pool.mutex);
+    pool.quit = true;
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.mutex);
+    for (uint32_t t = 1; t < num_threads; ++t) {
+        if (started[t])
+            pthread_join(threads[t], 0);
+    }
+    pthread_cond_destroy(&pool.done);
+    pthread_cond_destroy(&pool.start);
+    pthread_mutex_destroy(&pool.mutex);
+
+    random_position_stats_t stats = { .elapsed_ns = elapsed_ns };
+    for (uint32_t t = 0; t < num_threads; ++t) {
+        stats.num_positions += tasks[t].stats.num_positions;
+        stats.num_plies += tasks[t].stats.num_plies;
+        stats.num_retries += tasks[t].stats.num_retries;
+        free(tasks[t].text);
+    }
+    return stats;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "foundation/basic.h"
+#include "components.h"
+
+// Reachable positions from random playouts, for benchmarks and fuzzing
+// that shouldn't only see the start position. Position `i` of a seed is
+// the same regardless of the number of threads.
+
+typedef struct random_position_params_t {
+    uint64_t seed;
+    uint64_t num_positions;
+    // Playout length, uniform in the range. Playouts ending in mate or
+    // stalemate are played again, every position has a legal move.
+    uint32_t min_plies;
+    uint32_t max_plies;
+    // Zero uses one thread
+    uint32_t num_threads;
+} random_position_params_t;
+
+typedef struct random_position_stats_t {
+    uint64_t num_positions;
+    uint64_t num_plies;
+    // Playouts that ended early and were played again
+    uint64_t num_retries;
+    uint64_t elapsed_ns;
+} random_position_stats_t;
+
+// Plays `num_plies` uniformly random legal moves on `board` through
+// `rules_api`. Returns false if the game ended first.
+bool random_playout(board_component_t *board, uint64_t *rng, uint32_t num_plies);
+
+// Position `index` of `params->seed`
+void random_position(const random_position_params_t *params, uint64_t index, board_component_t *board, random_position_stats_t *stats);
+
+// Generates the positions on `num_threads` threads and writes them to `out`
+// as EPD, one per line and in index order, with the move number and an id
+// of seed and index. `out` can be null to only measure the playouts.
+// Nothing is generated if the text buffers can't be allocated.
+random_position_stats_t write_random_positions(const random_position_params_t *params, FILE *out);
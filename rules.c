@@ -0,0 +1,431 @@
+#include "rules.h"
+#include "move_tables.h"
+#include "foundation/log.h"
+
+move_info_t perform_move(board_component_t *board, int from, int to)
+{
+    uint8_t capture = board->indices[to];
+
+    move_info_t move_info = {
+        .move_type = capture ? MOVE_TYPE_CAPTURE : MOVE_TYPE_MOVE,
+        .capture = capture,
+        .capture_pos = to,
+        .last_castle_bits = board->castle_bits,
+        .last_en_passant_pos = board->en_passant_pos,
+        .promotion = 0,
+    };
+
+    if ((board->indices[from] & MASK_TYPE) == PIECE_KING) {
+        // King was moved; remove castling rights for both sides
+        board->castle_bits &= ~(3 << (board->current_player / 4));
+        // Castling happened; find which side and move the rook
+        if (abs(from - to) == 2) {
+            int rook_from = from + (from > to ? -3 : 4);
+            int rook_to = from + (from > to ? -1 : 1);
+            board->indices[rook_to] = board->indices[rook_from];
+            board->indices[rook_from] = 0;
+            move_info.move_type = MOVE_TYPE_CASTLE;
+            move_info.rook_pos = rook_from;
+        }
+    }
+
+    if ((board->indices[from] & MASK_TYPE) == PIECE_ROOK) {
+        // Revoke castling rights for own side
+        if (from == 0x0 || from == 0x70)
+            board->castle_bits &= ~(1 << (board->current_player / 4 + 0));
+        else if (from == 0x7 || from == 0x77)
+            board->castle_bits &= ~(1 << (board->current_player / 4 + 1));
+    }
+
+    if ((board->indices[to] & MASK_TYPE) == PIECE_ROOK) {
+        // Revoke castling rights for opponent side
+        uint8_t opponent = board->current_player == PIECE_WHITE ? PIECE_BLACK : PIECE_WHITE;
+        if (to == 0x0 || to == 0x70)
+            board->castle_bits &= ~(1 << (opponent / 4 + 0));
+        else if (to == 0x7 || to == 0x77)
+            board->castle_bits &= ~(1 << (opponent / 4 + 1));
+    }
+
+    if ((board->indices[from] & MASK_TYPE) == PIECE_PAWN) {
+        int diff = abs(from - to);
+        if (diff == 32) {
+            // Moved two squares ahead
+            board->en_passant_pos = to;
+        }
+        else if ((diff == 17 || diff == 15) && capture == 0) {
+            // En passant move
+            move_info.move_type = MOVE_TYPE_CAPTURE;
+            int pos = board->en_passant_pos;
+            move_info.capture_pos = pos;
+            move_info.capture = board->indices[pos];
+            board->indices[pos] = 0;
+            board->en_passant_pos = 0;
+        }
+        else {
+            board->en_passant_pos = 0;
+        }
+    } else {
+        board->en_passant_pos = 0;
+    }
+
+    if ((board->indices[from] & MASK_TYPE) == PIECE_PAWN) {
+        int row = to & MASK_ROW;
+        if (row == 0x00 || row == 0x70) {
+            const uint8_t piece_type = PIECE_QUEEN;
+            board->indices[from] = PIECE_QUEEN | (board->indices[from] & MASK_COLOR);
+            move_info.promotion = piece_type;
+        }
+    }
+
+    board->indices[to] = board->indices[from];
+    board->indices[from] = 0;
+
+    board->current_player = board->current_player == PIECE_WHITE ? PIECE_BLACK : PIECE_WHITE;
+    ++board->move_count;
+
+    return move_info;
+}
+
+void revert_move(board_component_t *board, int from, int to, const move_info_t *info)
+{   
+    board->indices[from] = board->indices[to];
+    // Set to zero in case the `capture_pos` was != `to`
+    board->indices[to] = 0;
+    board->indices[info->capture_pos] = info->capture;
+
+    board->castle_bits = info->last_castle_bits;
+    board->en_passant_pos = info->last_en_passant_pos;
+    
+    // Revert castling rook move
+    if (info->move_type == MOVE_TYPE_CASTLE) {
+        int rook_from = from + (from > to ? -3 : 4);
+        int rook_to = from + (from > to ? -1 : 1);
+        board->indices[rook_from] = board->indices[rook_to];
+        board->indices[rook_to] = 0;
+    }
+
+    // Revert promotion
+    if (info->promotion) {
+        board->indices[from] = PIECE_PAWN | (board->indices[from] & MASK_COLOR);
+    }
+
+    board->current_player = board->current_player == PIECE_WHITE ? PIECE_BLACK : PIECE_WHITE;
+    --board->move_count;
+}
+
+// Castling along castle bit `bit`; the path must be empty and the rook (or
+// a queen standing in for it) still in the corner.
+static bool can_castle(const board_component_t *board, int from, int bit)
+{
+    if ((board->castle_bits >> bit & 1) == 0 || from != castle_king_from[bit])
+        return false;
+
+    const uint8_t row = from & MASK_ROW;
+    for (uint8_t mask = castle_path_mask[bit]; mask; mask &= mask - 1) {
+        if (board->indices[row + __builtin_ctz(mask)] != 0)
+            return false;
+    }
+
+    const uint8_t rook = board->indices[castle_rook_from[bit]];
+    return (rook & MASK_COLOR) == board->current_player && ((rook & MASK_TYPE) == PIECE_ROOK || (rook & MASK_TYPE) == PIECE_QUEEN);
+}
+
+bool is_legal_move(board_component_t *board, int from, int to)
+{
+    if ((to & 0x88) != 0)
+        return false;
+
+    uint8_t piece_to_move = board->indices[from];
+    if (piece_to_move == 0)
+        return false;
+
+    if ((piece_to_move & MASK_COLOR) != board->current_player)
+        return false;
+
+    uint8_t piece_to_capture = board->indices[to];
+    if (piece_to_capture != 0 && (piece_to_capture & MASK_COLOR) == board->current_player)
+        return false;
+
+    const int diff = to - from;
+    const bool can_reach = (attack_by_diff[diff + DIFF_OFFSET] & piece_attacks[piece_to_move]) != 0;
+
+    switch (piece_to_move & MASK_TYPE) {
+        case PIECE_PAWN: {
+            const int forward = board->current_player == PIECE_WHITE ? -16 : 16;
+            const int home_row = board->current_player == PIECE_WHITE ? 0x60 : 0x10;
+            if (diff == forward)
+                return piece_to_capture == 0;
+            if (diff == 2 * forward)
+                return piece_to_capture == 0 && (from & MASK_ROW) == home_row && board->indices[from + forward] == 0;
+            if (!can_reach)
+                return false;
+            // Diagonal; either a capture or en passant next to `from`
+            return piece_to_capture != 0 || (board->en_passant_pos && from + diff - forward == board->en_passant_pos);
+        }
+        case PIECE_KNIGHT:
+            return can_reach;
+        case PIECE_KING: {
+            if (diff == 2 || diff == -2)
+                return can_castle(board, from, board->current_player / 4 + (diff < 0 ? 1 : 0));
+            return can_reach;
+        }
+    }
+
+    if (!can_reach)
+        return false;
+
+    // Sliding piece; the squares in between must be empty
+    const int step = direction_by_diff[diff + DIFF_OFFSET];
+    for (int path = from + step; path != to; path += step) {
+        if (board->indices[path] != 0)
+            return false;
+    }
+
+    return true;
+}
+
+bool is_piece_attacked(board_component_t *board, uint8_t piece)
+{
+    // Find piece position
+    int pos = 0;
+    for (int i = 0; i < 128; ++i) {
+        if (board->indices[i] == piece) {
+            pos = i;
+            break;
+        }
+    }
+
+    // Check if any piece can attack `pos`
+    bool attacked = false;
+    for (int i = 0; i < 128; ++i) {
+        if (is_legal_move(board, i, pos)) {
+            attacked = true;
+            break;
+        }
+    }
+
+    return attacked;
+}
+
+bool is_checked_after_move(board_component_t *board, int from, int to)
+{
+    move_info_t info = perform_move(board, from, to);
+
+    const uint8_t king_piece = PIECE_KING | (board->current_player == PIECE_WHITE ? PIECE_BLACK : PIECE_WHITE);
+    bool checked = is_piece_attacked(board, king_piece);
+    revert_move(board, from, to, &info);
+
+    return checked;
+}
+
+uint32_t check_end_condition_with_moves(board_component_t *board, const clock_component_t *clock, move_t *moves)
+{
+    if (clock && clock->flagged) {
+        board->game_state = clock->running_player == PIECE_WHITE ? STATE_BLACK_WIN_ON_TIME : STATE_WHITE_WIN_ON_TIME;
+        return 0;
+    }
+
+    const uint32_t num_legal_moves = generate_legal_moves(board, moves);
+    if (num_legal_moves > 0) {
+        board->game_state = STATE_PLAYING;
+        return num_legal_moves;
+    }
+
+    // Switch player temporarily to check if king is checked
+    const uint8_t player = board->current_player;
+    board->current_player = player == PIECE_WHITE ? PIECE_BLACK : PIECE_WHITE;
+    bool checked = is_piece_attacked(board, PIECE_KING | player);
+    board->current_player = player;
+
+    log_print(LOG_INFO, "No legal moves! Stalemate: %i", !checked);
+
+    if (checked)
+        board->game_state = player == PIECE_WHITE ? STATE_BLACK_WIN_BY_CHECKMATE: STATE_WHITE_WIN_BY_CHECKMATE;
+    else
+        board->game_state = STATE_DRAW_BY_STALEMATE;
+    return 0;
+}
+
+void check_end_condition_reached(board_component_t *board, const clock_component_t *clock)
+{
+    move_t moves[MAX_MOVES];
+    check_end_condition_with_moves(board, clock, moves);
+}
+
+void press_clock(clock_component_t *clock, uint64_t now_ns)
+{
+    if (!clock->running)
+        return;
+
+    int64_t *remaining = &clock->remaining_ns[clock->running_player / 8];
+    *remaining -= (int64_t)(now_ns - clock->turn_start_ns);
+    *remaining += (int64_t)clock->increment_ns;
+    clock->running_player = opponent_of(clock->running_player);
+    clock->turn_start_ns = now_ns;
+}
+
+bool is_square_attacked(board_component_t *board, int pos, uint8_t attacker)
+{
+    // Note: `pos` is expected to hold a piece of the defending side, so pawn
+    // pushes, en passant and castling (which needs an empty path) never count
+    // as attacks.
+    const uint8_t *b = board->indices;
+
+    // Pawns capture diagonally towards the opponent
+    const int pawn_from = attacker == PIECE_WHITE ? 16 : -16;
+    for (int side = -1; side <= 1; side += 2) {
+        int from = pos + pawn_from + side;
+        if (!(from & 0x88) && b[from] == (PIECE_PAWN | attacker))
+            return true;
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        int from = pos + knight_offsets[i];
+        if (!(from & 0x88) && b[from] == (PIECE_KNIGHT | attacker))
+            return true;
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        int from = pos + king_offsets[i];
+        if (!(from & 0x88) && b[from] == (PIECE_KING | attacker))
+            return true;
+    }
+
+    // Sliding pieces; the first piece along each line decides
+    for (int i = 0; i < 4; ++i) {
+        for (int from = pos + diagonal_steps[i]; !(from & 0x88); from += diagonal_steps[i]) {
+            uint8_t p = b[from];
+            if (p == 0)
+                continue;
+            if ((p & MASK_COLOR) == attacker && (piece_attacks[p] & ATTACK_DIAGONAL))
+                return true;
+            break;
+        }
+        for (int from = pos + straight_steps[i]; !(from & 0x88); from += straight_steps[i]) {
+            uint8_t p = b[from];
+            if (p == 0)
+                continue;
+            if ((p & MASK_COLOR) == attacker && (piece_attacks[p] & ATTACK_STRAIGHT))
+                return true;
+            break;
+        }
+    }
+
+    return false;
+}
+
+bool is_king_in_check(board_component_t *board, uint8_t player)
+{
+    const uint8_t king = PIECE_KING | player;
+    int pos = 0;
+    for (int i = 0; i < 128; ++i) {
+        if (board->indices[i] == king) {
+            pos = i;
+            break;
+        }
+    }
+    return is_square_attacked(board, pos, opponent_of(player));
+}
+
+static inline uint32_t add_move(move_t *moves, uint32_t n, int from, int to)
+{
+    moves[n] = (move_t) { .from = (uint8_t)from, .to = (uint8_t)to };
+    return n + 1;
+}
+
+static uint32_t generate_slides(const uint8_t *b, move_t *moves, uint32_t n, int from, const int8_t *steps, uint8_t player)
+{
+    for (int i = 0; i < 4; ++i) {
+        for (int to = from + steps[i]; !(to & 0x88); to += steps[i]) {
+            if (b[to] != 0) {
+                if ((b[to] & MASK_COLOR) != player)
+                    n = add_move(moves, n, from, to);
+                break;
+            }
+            n = add_move(moves, n, from, to);
+        }
+    }
+    return n;
+}
+
+uint32_t generate_moves(board_component_t *board, move_t *moves)
+{
+    const uint8_t *b = board->indices;
+    const uint8_t player = board->current_player;
+    uint32_t n = 0;
+
+    for (int from = 0; from < 128; ++from) {
+        uint8_t piece = b[from];
+        if ((from & 0x88) || piece == 0 || (piece & MASK_COLOR) != player)
+            continue;
+
+        switch (piece & MASK_TYPE) {
+            case PIECE_PAWN: {
+                const int forward = player == PIECE_WHITE ? -16 : 16;
+                int to = from + forward;
+                if (!(to & 0x88) && b[to] == 0) {
+                    n = add_move(moves, n, from, to);
+                    int row = from & MASK_ROW;
+                    int to2 = to + forward;
+                    if ((row == 0x60 || row == 0x10) && !(to2 & 0x88) && b[to2] == 0)
+                        n = add_move(moves, n, from, to2);
+                }
+                for (int side = -1; side <= 1; side += 2) {
+                    to = from + forward + side;
+                    if (to & 0x88)
+                        continue;
+                    if (b[to] != 0) {
+                        if ((b[to] & MASK_COLOR) != player)
+                            n = add_move(moves, n, from, to);
+                    }
+                    else if (board->en_passant_pos && from + side == board->en_passant_pos) {
+                        n = add_move(moves, n, from, to);
+                    }
+                }
+                break;
+            }
+            case PIECE_KNIGHT:
+            case PIECE_KING: {
+                const int8_t *offsets = (piece & MASK_TYPE) == PIECE_KNIGHT ? knight_offsets : king_offsets;
+                for (int i = 0; i < 8; ++i) {
+                    int to = from + offsets[i];
+                    if (!(to & 0x88) && (b[to] == 0 || (b[to] & MASK_COLOR) != player))
+                        n = add_move(moves, n, from, to);
+                }
+                if ((piece & MASK_TYPE) == PIECE_KING) {
+                    for (int bit = player / 4; bit < player / 4 + 2; ++bit) {
+                        if (can_castle(board, from, bit))
+                            n = add_move(moves, n, from, castle_king_to[bit]);
+                    }
+                }
+                break;
+            }
+            case PIECE_BISHOP:
+                n = generate_slides(b, moves, n, from, diagonal_steps, player);
+                break;
+            case PIECE_ROOK:
+                n = generate_slides(b, moves, n, from, straight_steps, player);
+                break;
+            case PIECE_QUEEN:
+                n = generate_slides(b, moves, n, from, diagonal_steps, player);
+                n = generate_slides(b, moves, n, from, straight_steps, player);
+                break;
+        }
+    }
+
+    return n;
+}
+
+uint32_t generate_legal_moves(board_component_t *board, move_t *moves)
+{
+    const uint8_t player = board->current_player;
+    uint32_t n = generate_moves(board, moves);
+    uint32_t num_legal = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        move_info_t info = perform_move(board, moves[i].from, moves[i].to);
+        if (!is_king_in_check(board, player))
+            moves[num_legal++] = moves[i];
+        revert_move(board, moves[i].from, moves[i].to, &info);
+    }
+    return num_legal;
+}
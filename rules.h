@@ -0,0 +1,79 @@
+#pragma once
+#include "foundation/basic.h"
+#include "chess.h"
+#include "components.h"
+
+enum {
+    MOVE_TYPE_MOVE,
+    MOVE_TYPE_CAPTURE,
+    MOVE_TYPE_CASTLE,
+};
+
+enum {
+    STATE_PLAYING,
+    STATE_WHITE_WIN_BY_CHECKMATE,
+    STATE_BLACK_WIN_BY_CHECKMATE,
+    STATE_DRAW_BY_STALEMATE,
+    STATE_WHITE_WIN_ON_TIME,
+    STATE_BLACK_WIN_ON_TIME,
+};
+
+enum {
+    // Upper bound of pseudo-legal moves in any position
+    MAX_MOVES = 256,
+};
+
+typedef struct move_info_t {
+    uint8_t move_type;
+    uint8_t capture;
+    int capture_pos;
+    int rook_pos; // Castling
+    uint8_t last_castle_bits;
+    int last_en_passant_pos;
+    uint8_t promotion;
+} move_info_t;
+
+// Move between two board positions in 0x88 coordinates
+typedef struct move_t {
+    uint8_t from;
+    uint8_t to;
+} move_t;
+
+static inline uint8_t opponent_of(uint8_t player)
+{
+    return player == PIECE_WHITE ? PIECE_BLACK : PIECE_WHITE;
+}
+
+move_info_t perform_move(board_component_t *board, int from, int to);
+void revert_move(board_component_t *board, int from, int to, const move_info_t *info);
+
+bool is_legal_move(board_component_t *board, int from, int to);
+bool is_piece_attacked(board_component_t *board, uint8_t piece);
+bool is_checked_after_move(board_component_t *board, int from, int to);
+
+// Stops the mover's time, adds the increment and starts the opponent's clock.
+void press_clock(clock_component_t *clock, uint64_t now_ns);
+// Time left on `player`'s clock at `now_ns`, never negative.
+static inline int64_t clock_remaining_ns(const clock_component_t *clock, uint8_t player, uint64_t now_ns)
+{
+    int64_t remaining = clock->remaining_ns[player / 8];
+    if (clock->running && clock->running_player == player)
+        remaining -= (int64_t)(now_ns - clock->turn_start_ns);
+    return remaining > 0 ? remaining : 0;
+}
+
+// True if any piece of `attacker` could move to `pos`, using the same rules as `is_legal_move`
+bool is_square_attacked(board_component_t *board, int pos, uint8_t attacker);
+bool is_king_in_check(board_component_t *board, uint8_t player);
+
+// Writes all moves accepted by `is_legal_move` for the current player into `moves`.
+// Returns the number of moves written (at most `MAX_MOVES`).
+uint32_t generate_moves(board_component_t *board, move_t *moves);
+// Same as `generate_moves` but drops moves that leave the own king checked.
+uint32_t generate_legal_moves(board_component_t *board, move_t *moves);
+
+// `clock` is optional; a fallen flag ends the game before any board checks.
+void check_end_condition_reached(board_component_t *board, const clock_component_t *clock);
+// Same, and keeps the legal moves of the player to move in `moves` (room for
+// `MAX_MOVES`). Returns their number, zero once the game is over.
+uint32_t check_end_condition_with_moves(board_component_t *board, const clock_component_t *clock, move_t *moves);
@@ -0,0 +1,77 @@
+#pragma once
+#include "foundation/basic.h"
+#include "rules.h"
+#include "search.h"
+#include <stddef.h>
+
+enum {
+    // Bump when functions are added, removed or change signature
+    RULES_API_VERSION = 4,
+};
+
+// Rules and AI entry points. Everything outside the rules module calls
+// through `rules_api` so the module can be rebuilt and swapped at runtime,
+// see `reload_rules_module`.
+typedef struct rules_api_t {
+    uint32_t version;
+    // `rules_layout_hash` as compiled into the module
+    uint64_t layout_hash;
+
+    move_info_t (*perform_move)(board_component_t *board, int from, int to);
+    void (*revert_move)(board_component_t *board, int from, int to, const move_info_t *info);
+    bool (*is_legal_move)(board_component_t *board, int from, int to);
+    bool (*is_checked_after_move)(board_component_t *board, int from, int to);
+    bool (*is_king_in_check)(board_component_t *board, uint8_t player);
+    bool (*is_square_attacked)(board_component_t *board, int pos, uint8_t attacker);
+    void (*check_end_condition_reached)(board_component_t *board, const clock_component_t *clock);
+    uint32_t (*check_end_condition_with_moves)(board_component_t *board, const clock_component_t *clock, move_t *moves);
+    void (*press_clock)(clock_component_t *clock, uint64_t now_ns);
+    uint32_t (*generate_moves)(board_component_t *board, move_t *moves);
+    uint32_t (*generate_legal_moves)(board_component_t *board, move_t *moves);
+
+    search_result_t (*search_best_move)(const board_component_t *board, const search_params_t *params);
+    int (*evaluate_board)(const board_component_t *board);
+    float (*effective_branching_factor)(const search_stats_t *stats);
+    // Called by every thread that searched, before the module is unloaded
+    void (*release_search_memory)(void);
+} rules_api_t;
+
+// Defined next to `builtin_rules_api`, so tools that only need the rules
+// don't link the reload code
+extern const rules_api_t *rules_api;
+
+// Name of the function a rules module exports, returning its `rules_api_t`
+#define RULES_MODULE_ENTRY "get_rules_api"
+typedef const rules_api_t *(*get_rules_api_f)(void);
+
+// Rules linked into the game, used until a module is loaded. `layout_hash` is
+// only filled in by the module entry.
+extern const rules_api_t builtin_rules_api;
+
+static inline uint64_t mix_layout(uint64_t hash, uint64_t value)
+{
+    return (hash ^ value) * 0x100000001b3ull;
+}
+
+// Changes with the size or field offsets of everything passed across the
+// module boundary. A module built against another layout is refused.
+static inline uint64_t rules_layout_hash(void)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    h = mix_layout(h, sizeof(board_component_t));
+    h = mix_layout(h, offsetof(board_component_t, indices));
+    h = mix_layout(h, offsetof(board_component_t, current_player));
+    h = mix_layout(h, offsetof(board_component_t, castle_bits));
+    h = mix_layout(h, offsetof(board_component_t, en_passant_pos));
+    h = mix_layout(h, offsetof(board_component_t, move_count));
+    h = mix_layout(h, offsetof(board_component_t, game_state));
+    h = mix_layout(h, offsetof(board_component_t, ai_players));
+    h = mix_layout(h, sizeof(clock_component_t));
+    h = mix_layout(h, sizeof(move_t));
+    h = mix_layout(h, sizeof(move_info_t));
+    h = mix_layout(h, sizeof(search_params_t));
+    h = mix_layout(h, sizeof(search_stats_t));
+    h = mix_layout(h, sizeof(search_result_t));
+    h = mix_layout(h, sizeof(rules_api_t));
+    return h;
+}
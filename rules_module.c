@@ -0,0 +1,45 @@
+// Entry point of the rules module. Linked into the game for the built-in
+// rules, and built on its own as a shared library for hot reloading:
+//
+//   cc -shared -fPIC -O2 -Wl,-Bsymbolic -o rules_module.so rules_module.c
+//      rules.c search.c time_manager.c transposition_table.c arena.c
+//
+// `-Bsymbolic` keeps calls inside the library from resolving to the copies
+// linked into the game. The game must export the engine functions the
+// rules use (`log_print`), e.g. by linking with `-rdynamic`.
+#include "rules_api.h"
+
+#if defined(__GNUC__)
+#define RULES_MODULE_EXPORT __attribute__((visibility("default")))
+#else
+#define RULES_MODULE_EXPORT
+#endif
+
+const rules_api_t builtin_rules_api = {
+    .version = RULES_API_VERSION,
+    .perform_move = perform_move,
+    .revert_move = revert_move,
+    .is_legal_move = is_legal_move,
+    .is_checked_after_move = is_checked_after_move,
+    .is_king_in_check = is_king_in_check,
+    .is_square_attacked = is_square_attacked,
+    .check_end_condition_reached = check_end_condition_reached,
+    .check_end_condition_with_moves = check_end_condition_with_moves,
+    .press_clock = press_clock,
+    .generate_moves = generate_moves,
+    .generate_legal_moves = generate_legal_moves,
+    .search_best_move = search_best_move,
+    .evaluate_board = evaluate_board,
+    .effective_branching_factor = effective_branching_factor,
+    .release_search_memory = release_search_memory,
+};
+
+const rules_api_t *rules_api = &builtin_rules_api;
+
+RULES_MODULE_EXPORT const rules_api_t *get_rules_api(void)
+{
+    static rules_api_t api;
+    api = builtin_rules_api;
+    api.layout_hash = rules_layout_hash();
+    return &api;
+}
@@ -0,0 +1,199 @@
+#include "rules_reload.h"
+#include "rules_api.h"
+#include "simulation.h"
+#include "random_positions.h"
+#include "fen.h"
+#include "monotonic_clock.h"
+#include "foundation/log.h"
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static struct {
+    void *handle;
+    // Identifies the build that was last tried, loaded or not
+    struct timespec mtime;
+    off_t size;
+    uint32_t num_loads;
+    uint64_t last_perft_nodes;
+} module;
+
+// Loading a copy keeps the build free to overwrite the library, and makes
+// sure `dlopen` doesn't hand back the previous build cached by path
+static bool copy_module(const char *from, const char *to)
+{
+    const int in = open(from, O_RDONLY);
+    if (in < 0)
+        return false;
+    const int out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0700);
+    if (out < 0) {
+        close(in);
+        return false;
+    }
+
+    bool ok = true;
+    char buffer[64 * 1024];
+    ssize_t n;
+    while ((n = read(in, buffer, sizeof(buffer))) > 0) {
+        if (write(out, buffer, (size_t)n) != n) {
+            ok = false;
+            break;
+        }
+    }
+    ok = ok && n == 0;
+    close(in);
+    close(out);
+    return ok;
+}
+
+static void *open_module(const char *path, const rules_api_t **api)
+{
+    char copy[256];
+    snprintf(copy, sizeof(copy), "/tmp/rules_module.%i.%u.so", (int)getpid(), module.num_loads);
+    if (!copy_module(path, copy)) {
+        log_print(LOG_ERROR, "Failed to copy rules module '%s'", path);
+        return 0;
+    }
+
+    void *handle = dlopen(copy, RTLD_NOW | RTLD_LOCAL);
+    // The mapping stays valid after the file is gone
+    unlink(copy);
+    if (!handle) {
+        log_print(LOG_ERROR, "Failed to load rules module '%s': %s", path, dlerror());
+        return 0;
+    }
+
+    get_rules_api_f entry = (get_rules_api_f)dlsym(handle, RULES_MODULE_ENTRY);
+    const rules_api_t *loaded = entry ? entry() : 0;
+    if (!loaded) {
+        log_print(LOG_ERROR, "Rules module '%s' has no '%s'", path, RULES_MODULE_ENTRY);
+        dlclose(handle);
+        return 0;
+    }
+    if (loaded->version != RULES_API_VERSION) {
+        log_print(LOG_ERROR, "Rules module '%s' has API version %u, expected %u", path, loaded->version, RULES_API_VERSION);
+        dlclose(handle);
+        return 0;
+    }
+    if (loaded->layout_hash != rules_layout_hash()) {
+        log_print(LOG_ERROR, "Rules module '%s' was built against another board layout", path);
+        dlclose(handle);
+        return 0;
+    }
+
+    *api = loaded;
+    return handle;
+}
+
+// Nothing may run rules code while it's replaced
+static void swap_rules(const rules_api_t *api, void *handle)
+{
+    const bool restart = is_simulation_thread_running();
+    if (restart)
+        stop_simulation_thread();
+
+    const rules_api_t *old = rules_api;
+    rules_api = api;
+    // The simulation thread freed its search memory when it stopped, the
+    // benchmark and AI without the thread searched on this one
+    if (module.handle) {
+        old->release_search_memory();
+        dlclose(module.handle);
+    }
+    module.handle = handle;
+
+    if (restart)
+        start_simulation_thread();
+}
+
+bool reload_rules_module(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+    if (st.st_mtim.tv_sec == module.mtime.tv_sec && st.st_mtim.tv_nsec == module.mtime.tv_nsec && st.st_size == module.size)
+        return false;
+
+    // Remembered even if loading fails, so a broken build isn't retried every frame
+    module.mtime = st.st_mtim;
+    module.size = st.st_size;
+
+    const rules_api_t *api = 0;
+    void *handle = open_module(path, &api);
+    if (!handle)
+        return false;
+
+    swap_rules(api, handle);
+    ++module.num_loads;
+    log_print(LOG_INFO, "Loaded rules module '%s' (%u)", path, module.num_loads);
+
+    const rules_benchmark_t b = run_rules_benchmark();
+    log_print(LOG_INFO, "Rules benchmark: perft(4) %llu nodes in %.1f ms, search depth %u %llu nodes in %.1f ms, %llu moves of %u random positions in %.2f ms",
+        (unsigned long long)b.perft_nodes, time_ns_to_ms(b.perft_ns), b.search_depth,
+        (unsigned long long)b.search_nodes, time_ns_to_ms(b.search_ns),
+        (unsigned long long)b.movegen_moves, RULES_BENCHMARK_POSITIONS, time_ns_to_ms(b.movegen_ns));
+    if (module.last_perft_nodes && module.last_perft_nodes != b.perft_nodes)
+        log_print(LOG_WARN, "Move generation changed, perft(4) was %llu", (unsigned long long)module.last_perft_nodes);
+    module.last_perft_nodes = b.perft_nodes;
+    return true;
+}
+
+void unload_rules_module(void)
+{
+    if (module.handle)
+        swap_rules(&builtin_rules_api, 0);
+    module.mtime = (struct timespec) { 0 };
+    module.size = 0;
+}
+
+static uint64_t perft(board_component_t *board, uint32_t depth)
+{
+    move_t moves[MAX_MOVES];
+    const uint32_t n = rules_api->generate_legal_moves(board, moves);
+    if (depth <= 1)
+        return n;
+
+    uint64_t nodes = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        const move_info_t info = rules_api->perform_move(board, moves[i].from, moves[i].to);
+        nodes += perft(board, depth - 1);
+        rules_api->revert_move(board, moves[i].from, moves[i].to, &info);
+    }
+    return nodes;
+}
+
+rules_benchmark_t run_rules_benchmark(void)
+{
+    board_component_t board = { .selected_piece = { .id = UINT64_MAX } };
+    set_start_position(&board);
+
+    rules_benchmark_t b = { 0 };
+    uint64_t start = time_now_ns();
+    b.perft_nodes = perft(&board, 4);
+    b.perft_ns = time_now_ns() - start;
+
+    const search_params_t params = { .max_depth = 6 };
+    start = time_now_ns();
+    const search_result_t result = rules_api->search_best_move(&board, &params);
+    b.search_ns = time_now_ns() - start;
+    b.search_nodes = result.stats.nodes;
+    b.search_depth = result.stats.depth;
+
+    // The start position alone says little about move generation
+    board_component_t *positions = malloc(RULES_BENCHMARK_POSITIONS * sizeof(board_component_t));
+    if (!positions)
+        return b;
+    const random_position_params_t random_params = { .seed = 1, .min_plies = 10, .max_plies = 80 };
+    random_position_stats_t random_stats = { 0 };
+    for (uint32_t i = 0; i < RULES_BENCHMARK_POSITIONS; ++i)
+        random_position(&random_params, i, &positions[i], &random_stats);
+
+    move_t moves[MAX_MOVES];
+    start = time_now_ns();
+    for (uint32_t i = 0; i < RULES_BENCHMARK_POSITIONS; ++i)
+        b.movegen_moves += rules_api->generate_legal_moves(&positions[i], moves);
+    b.movegen_ns = time_now_ns() - start;
+    free(positions);
+    return b;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "foundation/basic.h"
+
+enum {
+    // Positions of a fixed seed, see `random_position`
+    RULES_BENCHMARK_POSITIONS = 1024,
+};
+
+typedef struct rules_benchmark_t {
+    // Leaf nodes of a depth 4 perft from the start position
+    uint64_t perft_nodes;
+    uint64_t perft_ns;
+    uint64_t search_nodes;
+    uint32_t search_depth;
+    uint64_t search_ns;
+    // Legal moves summed over `RULES_BENCHMARK_POSITIONS` random positions
+    uint64_t movegen_moves;
+    uint64_t movegen_ns;
+} rules_benchmark_t;
+
+// Loads the rules module at `path` if it was rebuilt since the last call,
+// e.g. once per frame. The simulation thread is stopped for the swap and
+// restarted. A module built against another board layout or API version is
+// refused and the current rules stay active. Returns true when a new module
+// was swapped in; the benchmark runs right after and is logged.
+bool reload_rules_module(const char *path);
+
+// Goes back to the rules linked into the game
+void unload_rules_module(void);
+
+// Times move generation and a fixed depth search through `rules_api`.
+// Returns zero move generation results if the positions can't be allocated.
+rules_benchmark_t run_rules_benchmark(void);
@@ -0,0 +1,525 @@
+#include "search.h"
+#include "foundation/log.h"
+#include "monotonic_clock.h"
+#include "transposition_table.h"
+#include "arena.h"
+#include <pthread.h>
+
+static const int piece_values[8] = { 0, 100, 320, 0, 0, 330, 500, 900 };
+
+// Bonus for being close to the center, indexed by `x + z * 8`
+static const int8_t center_bonus[64] = {
+    0, 1, 2, 3, 3, 2, 1, 0,
+    1, 3, 4, 5, 5, 4, 3, 1,
+    2, 4, 6, 7, 7, 6, 4, 2,
+    3, 5, 7, 8, 8, 7, 5, 3,
+    3, 5, 7, 8, 8, 7, 5, 3,
+    2, 4, 6, 7, 7, 6, 4, 2,
+    1, 3, 4, 5, 5, 4, 3, 1,
+    0, 1, 2, 3, 3, 2, 1, 0,
+};
+
+// Margins indexed by remaining depth at frontier nodes
+static const int futility_margins[3] = { 0, 200, 500 };
+static const int razor_margins[3] = { 0, 300, 550 };
+
+enum {
+    // Table used when no table was set up before the first search
+    DEFAULT_TT_SIZE_MB = 16,
+    // Move lists of the deepest line plus the per iteration buffers
+    SEARCH_ARENA_CAPACITY = 256 * 1024,
+};
+
+enum {
+    ORDER_PV = 1 << 30,
+    ORDER_HASH = 1 << 29,
+    ORDER_CAPTURE = 1 << 24,
+    ORDER_KILLER_1 = 1 << 23,
+    ORDER_KILLER_2 = 1 << 22,
+    // History scores are clamped below the killers
+    MAX_HISTORY = 1 << 21,
+};
+
+typedef struct search_state_t {
+    board_component_t board;
+    // Zobrist hash of `board`, updated with every move made in `search`
+    uint64_t key;
+    search_params_t params;
+    search_stats_t stats;
+    time_manager_t time;
+    bool stopped;
+    // Nodes spent below the best root move of the current iteration
+    uint64_t best_move_nodes;
+    move_t killers[MAX_SEARCH_DEPTH][2];
+    int history[128][128];
+    // Per iteration buffers from `search_arena`; triangular principal
+    // variation table and undo records indexed by ply
+    move_t (*pv)[MAX_SEARCH_DEPTH];
+    uint32_t *pv_length;
+    move_info_t *undo;
+    // Principal variation of the last completed iteration, searched first
+    move_t last_pv[MAX_SEARCH_DEPTH];
+    uint32_t last_pv_length;
+} search_state_t;
+
+// Each thread searches with its own state and arena. Move lists are pushed
+// on the arena per node and popped on return; everything is reset at the
+// start of each iteration. The transposition table is shared by all threads.
+static _Thread_local search_state_t state;
+static _Thread_local arena_t search_arena;
+
+// The first search on any thread sets up the default table
+static pthread_mutex_t tt_setup_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline bool same_move(move_t a, move_t b)
+{
+    return a.from == b.from && a.to == b.to;
+}
+
+int evaluate_board(const board_component_t *board)
+{
+    int score = 0;
+    for (int z = 0; z < 8; ++z) {
+        for (int x = 0; x < 8; ++x) {
+            uint8_t piece = board->indices[x + z * 16];
+            if (piece == 0)
+                continue;
+
+            const bool white = (piece & MASK_COLOR) == PIECE_WHITE;
+            const int center = center_bonus[x + z * 8];
+            int value = piece_values[piece & MASK_TYPE];
+            switch (piece & MASK_TYPE) {
+                case PIECE_PAWN: value += (white ? 6 - z : z - 1) * 8 + center; break;
+                case PIECE_KNIGHT: value += center * 4; break;
+                case PIECE_BISHOP: value += center * 2; break;
+                case PIECE_QUEEN: value += center; break;
+                case PIECE_KING: value -= center * 3; break;
+            }
+            score += white ? value : -value;
+        }
+    }
+    return score;
+}
+
+static inline int evaluate_for_player(const board_component_t *board)
+{
+    int score = evaluate_board(board);
+    return board->current_player == PIECE_WHITE ? score : -score;
+}
+
+// Null moves are unsafe in pawn endings where zugzwang is common
+static bool has_non_pawn_material(const board_component_t *board, uint8_t player)
+{
+    for (int i = 0; i < 128; ++i) {
+        uint8_t piece = board->indices[i];
+        if (piece != 0 && (piece & MASK_COLOR) == player && (piece & MASK_TYPE) != PIECE_PAWN && (piece & MASK_TYPE) != PIECE_KING)
+            return true;
+    }
+    return false;
+}
+
+static inline bool is_capture(const board_component_t *board, move_t m)
+{
+    if (board->indices[m.to] != 0)
+        return true;
+    // En passant; diagonal pawn move onto an empty square
+    int diff = abs(m.from - m.to);
+    return (board->indices[m.from] & MASK_TYPE) == PIECE_PAWN && (diff == 15 || diff == 17);
+}
+
+static inline bool is_promotion(const board_component_t *board, move_t m)
+{
+    int row = m.to & MASK_ROW;
+    return (board->indices[m.from] & MASK_TYPE) == PIECE_PAWN && (row == 0x00 || row == 0x70);
+}
+
+static void score_moves(search_state_t *s, const move_t *moves, int *scores, uint32_t n, uint32_t ply, move_t hash_move)
+{
+    const board_component_t *board = &s->board;
+    const bool has_pv_move = ply < s->last_pv_length;
+    for (uint32_t i = 0; i < n; ++i) {
+        move_t m = moves[i];
+        if (has_pv_move && same_move(m, s->last_pv[ply])) {
+            scores[i] = ORDER_PV;
+        }
+        else if (same_move(m, hash_move)) {
+            scores[i] = ORDER_HASH;
+        }
+        else if (is_capture(board, m) || is_promotion(board, m)) {
+            // Most valuable victim, least valuable attacker
+            uint8_t victim = board->indices[m.to];
+            int victim_value = victim ? piece_values[victim & MASK_TYPE] : piece_values[PIECE_PAWN];
+            if (is_promotion(board, m))
+                victim_value += piece_values[PIECE_QUEEN];
+            scores[i] = ORDER_CAPTURE + victim_value * 16 - piece_values[board->indices[m.from] & MASK_TYPE] / 16;
+        }
+        else if (same_move(m, s->killers[ply][0])) {
+            scores[i] = ORDER_KILLER_1;
+        }
+        else if (same_move(m, s->killers[ply][1])) {
+            scores[i] = ORDER_KILLER_2;
+        }
+        else {
+            scores[i] = s->history[m.from][m.to];
+        }
+    }
+}
+
+// Swaps the best remaining move into slot `i`
+static inline void pick_move(move_t *moves, int *scores, uint32_t n, uint32_t i)
+{
+    uint32_t best = i;
+    for (uint32_t j = i + 1; j < n; ++j) {
+        if (scores[j] > scores[best])
+            best = j;
+    }
+    move_t m = moves[i]; moves[i] = moves[best]; moves[best] = m;
+    int sc = scores[i]; scores[i] = scores[best]; scores[best] = sc;
+}
+
+static inline bool out_of_budget(search_state_t *s)
+{
+    if (s->params.max_nodes && s->stats.nodes >= s->params.max_nodes)
+        s->stopped = true;
+    // Reading the clock is comparatively slow, only do it every few nodes
+    if ((s->stats.nodes & (TIME_CHECK_INTERVAL - 1)) == 0 && time_manager_hard_limit_reached(&s->time, time_now_ns()))
+        s->stopped = true;
+    return s->stopped;
+}
+
+static int quiesce(search_state_t *s, uint32_t ply, int alpha, int beta)
+{
+    ++s->stats.nodes;
+    ++s->stats.qnodes;
+    if (out_of_budget(s))
+        return 0;
+
+    board_component_t *board = &s->board;
+    int stand_pat = evaluate_for_player(board);
+    if (stand_pat >= beta || ply >= MAX_SEARCH_DEPTH - 1)
+        return stand_pat;
+    if (stand_pat > alpha)
+        alpha = stand_pat;
+
+    const size_t mark = arena_mark(&search_arena);
+    move_t *moves = arena_push_array(&search_arena, move_t, MAX_MOVES);
+    int *scores = arena_push_array(&search_arena, int, MAX_MOVES);
+
+    // Only captures and promotions are searched
+    uint32_t num_all = generate_moves(board, moves);
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < num_all; ++i) {
+        if (is_capture(board, moves[i]) || is_promotion(board, moves[i]))
+            moves[n++] = moves[i];
+    }
+    score_moves(s, moves, scores, n, ply, (move_t) { 0 });
+
+    const uint8_t player = board->current_player;
+    move_info_t *info = &s->undo[ply];
+    int result = alpha;
+    for (uint32_t i = 0; i < n; ++i) {
+        pick_move(moves, scores, n, i);
+        move_t m = moves[i];
+        *info = perform_move(board, m.from, m.to);
+        if (is_king_in_check(board, player)) {
+            revert_move(board, m.from, m.to, info);
+            continue;
+        }
+        int score = -quiesce(s, ply + 1, -beta, -result);
+        revert_move(board, m.from, m.to, info);
+
+        if (s->stopped) {
+            result = 0;
+            break;
+        }
+        if (score > result)
+            result = score;
+        if (result >= beta)
+            break;
+    }
+
+    arena_rewind(&search_arena, mark);
+    return result;
+}
+
+// Mate scores are stored relative to the node so they stay valid at any ply
+static inline int score_to_tt(int score, uint32_t ply)
+{
+    if (score >= SCORE_MATE_BOUND) return score + (int)ply;
+    if (score <= -SCORE_MATE_BOUND) return score - (int)ply;
+    return score;
+}
+
+static inline int score_from_tt(int score, uint32_t ply)
+{
+    if (score >= SCORE_MATE_BOUND) return score - (int)ply;
+    if (score <= -SCORE_MATE_BOUND) return score + (int)ply;
+    return score;
+}
+
+static int search(search_state_t *s, int depth, uint32_t ply, int alpha, int beta, bool allow_null)
+{
+    s->pv_length[ply] = ply;
+
+    if (depth <= 0 || ply >= MAX_SEARCH_DEPTH - 1)
+        return quiesce(s, ply, alpha, beta);
+
+    ++s->stats.nodes;
+    if (out_of_budget(s))
+        return 0;
+
+    board_component_t *board = &s->board;
+    const search_params_t *params = &s->params;
+    const uint8_t player = board->current_player;
+    const bool in_check = is_king_in_check(board, player);
+    const bool pv_node = beta - alpha > 1;
+    const int static_eval = in_check ? -SCORE_INFINITE : evaluate_for_player(board);
+    const int original_alpha = alpha;
+
+    const uint64_t key = s->key;
+    move_t hash_move = { 0 };
+    tt_hit_t hit;
+    ++s->stats.tt_probes;
+    if (tt_probe(key, &hit)) {
+        ++s->stats.tt_hits;
+        if (hit.foreign)
+            ++s->stats.tt_foreign_hits;
+        hash_move = hit.move;
+        if (!pv_node && hit.depth >= depth) {
+            int score = score_from_tt(hit.score, ply);
+            if (hit.bound == TT_BOUND_EXACT || (hit.bound == TT_BOUND_LOWER && score >= beta) || (hit.bound == TT_BOUND_UPPER && score <= alpha)) {
+                ++s->stats.tt_cutoffs;
+                return score;
+            }
+        }
+    }
+
+    // Razoring; hopeless frontier nodes drop straight into quiescence
+    if (!params->disable_futility && !pv_node && !in_check && depth <= 2 && static_eval + razor_margins[depth] <= alpha) {
+        int score = quiesce(s, ply, alpha, alpha + 1);
+        if (score <= alpha) {
+            ++s->stats.razor_prunes;
+            return score;
+        }
+    }
+
+    // Null move pruning; give the opponent a free move and see if we still fail high
+    if (!params->disable_null_move && allow_null && !pv_node && !in_check && depth >= 3 && static_eval >= beta && has_non_pawn_material(board, player)) {
+        const int r = depth > 6 ? 3 : 2;
+        const int en_passant_pos = board->en_passant_pos;
+        board->en_passant_pos = 0;
+        board->current_player = opponent_of(player);
+        s->key = key ^ zobrist.en_passant[en_passant_pos & 0x7f] ^ zobrist.en_passant[0] ^ zobrist.black_to_move;
+        int score = -search(s, depth - 1 - r, ply + 1, -beta, -beta + 1, false);
+        s->key = key;
+        board->current_player = player;
+        board->en_passant_pos = en_passant_pos;
+
+        if (s->stopped)
+            return 0;
+        if (score >= beta) {
+            ++s->stats.null_move_cutoffs;
+            return score >= SCORE_MATE_BOUND ? beta : score;
+        }
+    }
+
+    // Futility pruning; quiet moves can't raise a frontier node above alpha
+    const bool futile = !params->disable_futility && !pv_node && !in_check && depth <= 2 && static_eval + futility_margins[depth] <= alpha;
+
+    const size_t mark = arena_mark(&search_arena);
+    move_t *moves = arena_push_array(&search_arena, move_t, MAX_MOVES);
+    int *scores = arena_push_array(&search_arena, int, MAX_MOVES);
+    uint32_t n = generate_moves(board, moves);
+    score_moves(s, moves, scores, n, ply, hash_move);
+    move_info_t *info = &s->undo[ply];
+
+    int best_score = -SCORE_INFINITE;
+    move_t best_move = { 0 };
+    uint32_t num_legal = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        pick_move(moves, scores, n, i);
+        move_t m = moves[i];
+        const bool quiet = !is_capture(board, m) && !is_promotion(board, m);
+        const bool killer = scores[i] == ORDER_KILLER_1 || scores[i] == ORDER_KILLER_2;
+        const uint8_t piece = board->indices[m.from];
+
+        *info = perform_move(board, m.from, m.to);
+        if (is_king_in_check(board, player)) {
+            revert_move(board, m.from, m.to, info);
+            continue;
+        }
+        ++num_legal;
+        const uint64_t nodes_before = s->stats.nodes;
+
+        const bool gives_check = is_king_in_check(board, board->current_player);
+        if (futile && num_legal > 1 && quiet && !gives_check) {
+            revert_move(board, m.from, m.to, info);
+            ++s->stats.futility_prunes;
+            continue;
+        }
+
+        s->key = hash_after_move(key, board, m.from, m.to, piece, info);
+        // Checks are extended one ply
+        const int new_depth = depth - 1 + (gives_check ? 1 : 0);
+        int score;
+        if (num_legal == 1) {
+            score = -search(s, new_depth, ply + 1, -beta, -alpha, true);
+        }
+        else {
+            // Late move reductions; moves ordered late rarely turn out best
+            int reduction = 0;
+            if (!params->disable_late_move_reductions && depth >= 3 && num_legal > 3 && quiet && !killer && !in_check && !gives_check) {
+                reduction = (num_legal > 8 && depth >= 6) ? 2 : 1;
+                ++s->stats.reductions;
+            }
+
+            score = -search(s, new_depth - reduction, ply + 1, -alpha - 1, -alpha, true);
+            if (score > alpha && reduction) {
+                ++s->stats.reduction_researches;
+                score = -search(s, new_depth, ply + 1, -alpha - 1, -alpha, true);
+            }
+            if (score > alpha && score < beta)
+                score = -search(s, new_depth, ply + 1, -beta, -alpha, true);
+        }
+        revert_move(board, m.from, m.to, info);
+        s->key = key;
+
+        if (s->stopped)
+            break;
+
+        if (score > best_score) {
+            best_score = score;
+            best_move = m;
+        }
+
+        if (score > alpha) {
+            alpha = score;
+            if (ply == 0)
+                s->best_move_nodes = s->stats.nodes - nodes_before;
+
+            s->pv[ply][ply] = m;
+            for (uint32_t j = ply + 1; j < s->pv_length[ply + 1]; ++j)
+                s->pv[ply][j] = s->pv[ply + 1][j];
+            s->pv_length[ply] = s->pv_length[ply + 1];
+
+            if (alpha >= beta) {
+                if (quiet) {
+                    if (!same_move(m, s->killers[ply][0])) {
+                        s->killers[ply][1] = s->killers[ply][0];
+                        s->killers[ply][0] = m;
+                    }
+                    int *h = &s->history[m.from][m.to];
+                    *h += depth * depth;
+                    if (*h > MAX_HISTORY)
+                        *h = MAX_HISTORY;
+                }
+                break;
+            }
+        }
+    }
+
+    arena_rewind(&search_arena, mark);
+
+    if (s->stopped)
+        return 0;
+    if (num_legal == 0)
+        return in_check ? -SCORE_MATE + (int)ply : 0;
+
+    const uint8_t bound = best_score >= beta ? TT_BOUND_LOWER : (best_score > original_alpha ? TT_BOUND_EXACT : TT_BOUND_UPPER);
+    tt_store(key, best_move, score_to_tt(best_score, ply), depth, bound);
+
+    return best_score;
+}
+
+search_result_t search_best_move(const board_component_t *board, const search_params_t *params)
+{
+    search_state_t *s = &state;
+    memset(s, 0, sizeof(*s));
+    s->board = *board;
+    s->params = *params;
+    time_manager_start(&s->time, &params->time, params->max_time_ms, time_now_ns());
+
+    pthread_mutex_lock(&tt_setup_mutex);
+    if (!tt_is_ready())
+        tt_init(DEFAULT_TT_SIZE_MB);
+    pthread_mutex_unlock(&tt_setup_mutex);
+    tt_new_search();
+    s->key = board_hash(&s->board);
+    s->stats.soft_limit_ns = s->time.soft_limit_ns;
+    s->stats.hard_limit_ns = s->time.hard_limit_ns;
+
+    search_result_t result = { 0 };
+
+    arena_reset(&search_arena);
+    arena_reserve(&search_arena, SEARCH_ARENA_CAPACITY);
+    const uint64_t heap_allocations = arena_heap_allocations();
+
+    // Make sure there is a move even if the budget runs out during the first iteration
+    move_t *moves = arena_push_array(&search_arena, move_t, MAX_MOVES);
+    uint32_t num_moves = generate_legal_moves(&s->board, moves);
+    if (num_moves == 0)
+        return result;
+    result.has_move = true;
+    result.best_move = moves[0];
+
+    // Nothing to think about on the clock
+    if (num_moves == 1 && s->time.timed) {
+        result.stats = s->stats;
+        return result;
+    }
+
+    const uint32_t max_depth = (params->max_depth && params->max_depth < MAX_SEARCH_DEPTH) ? params->max_depth : MAX_SEARCH_DEPTH - 1;
+    for (uint32_t depth = 1; depth <= max_depth; ++depth) {
+        arena_reset(&search_arena);
+        s->pv = arena_alloc(&search_arena, sizeof(move_t) * MAX_SEARCH_DEPTH * MAX_SEARCH_DEPTH, _Alignof(move_t));
+        s->pv_length = arena_push_array(&search_arena, uint32_t, MAX_SEARCH_DEPTH);
+        s->undo = arena_push_array(&search_arena, move_info_t, MAX_SEARCH_DEPTH);
+
+        uint64_t nodes_before = s->stats.nodes;
+        int score = search(s, (int)depth, 0, -SCORE_INFINITE, SCORE_INFINITE, false);
+
+        // A partial iteration is still usable since the previous best move is searched first
+        if (s->pv_length[0] > 0) {
+            result.best_move = s->pv[0][0];
+            if (!s->stopped)
+                result.score = score;
+        }
+        if (s->stopped)
+            break;
+
+        s->stats.iteration_nodes[depth] = s->stats.nodes - nodes_before;
+        s->stats.depth = depth;
+        s->last_pv_length = s->pv_length[0];
+        memcpy(s->last_pv, s->pv[0], sizeof(move_t) * s->pv_length[0]);
+
+        if (score >= SCORE_MATE_BOUND || score <= -SCORE_MATE_BOUND)
+            break;
+
+        float best_move_share = s->stats.iteration_nodes[depth] ? (float)s->best_move_nodes / (float)s->stats.iteration_nodes[depth] : 0.0f;
+        if (!time_manager_continue(&s->time, result.best_move, score, best_move_share, time_now_ns()))
+            break;
+    }
+
+    s->stats.heap_allocations = arena_heap_allocations() - heap_allocations;
+    s->stats.arena_peak = search_arena.peak;
+
+    s->stats.elapsed_ns = time_now_ns() - s->time.start_ns;
+    result.stats = s->stats;
+    return result;
+}
+
+void release_search_memory(void)
+{
+    arena_free(&search_arena);
+    pthread_mutex_lock(&tt_setup_mutex);
+    tt_shutdown();
+    pthread_mutex_unlock(&tt_setup_mutex);
+}
+
+float effective_branching_factor(const search_stats_t *stats)
+{
+    if (stats->depth < 2 || stats->iteration_nodes[1] == 0)
+        return 0.0f;
+    double ratio = (double)stats->iteration_nodes[stats->depth] / (double)stats->iteration_nodes[1];
+    return (float)pow(ratio, 1.0 / (double)(stats->depth - 1));
+}
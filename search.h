@@ -0,0 +1,79 @@
+#pragma once
+#include "foundation/basic.h"
+#include "rules.h"
+#include "time_manager.h"
+
+enum {
+    MAX_SEARCH_DEPTH = 64,
+    // Nodes between clock reads, must be a power of two
+    TIME_CHECK_INTERVAL = 1024,
+    SCORE_INFINITE = 32000,
+    SCORE_MATE = 30000,
+    // Scores beyond this are mate in N
+    SCORE_MATE_BOUND = SCORE_MATE - MAX_SEARCH_DEPTH,
+};
+
+typedef struct search_params_t {
+    // Deepest iteration to search, zero means `MAX_SEARCH_DEPTH`
+    uint32_t max_depth;
+    // Stop searching after this many nodes, zero means no limit
+    uint64_t max_nodes;
+    // Fixed thinking time per move in milliseconds, zero means no limit
+    uint32_t max_time_ms;
+    // Game clock of the side to move, allocates time when running
+    time_control_t time;
+    // Selective pruning can be turned off to measure its effect
+    bool disable_null_move;
+    bool disable_late_move_reductions;
+    bool disable_futility;
+} search_params_t;
+
+typedef struct search_stats_t {
+    uint64_t nodes;
+    uint64_t qnodes;
+    // Nodes spent on each iteration of the iterative deepening
+    uint64_t iteration_nodes[MAX_SEARCH_DEPTH + 1];
+    // Deepest fully completed iteration
+    uint32_t depth;
+    uint64_t elapsed_ns;
+    // Limits handed out by the time manager, zero when untimed
+    uint64_t soft_limit_ns;
+    uint64_t hard_limit_ns;
+    uint64_t null_move_cutoffs;
+    uint64_t reductions;
+    uint64_t reduction_researches;
+    uint64_t futility_prunes;
+    uint64_t razor_prunes;
+    uint64_t tt_probes;
+    uint64_t tt_hits;
+    // Hits on entries stored by other processes sharing the table
+    uint64_t tt_foreign_hits;
+    uint64_t tt_cutoffs;
+    // Heap allocations made while searching, expected to be zero
+    uint64_t heap_allocations;
+    // Scratch memory used by the last iteration
+    size_t arena_peak;
+} search_stats_t;
+
+typedef struct search_result_t {
+    bool has_move;
+    move_t best_move;
+    // Score in centipawns for the side to move
+    int score;
+    search_stats_t stats;
+} search_result_t;
+
+// Iterative deepening alpha-beta search of `board` for the current player.
+// `board` is copied and never modified.
+search_result_t search_best_move(const board_component_t *board, const search_params_t *params);
+
+// Static evaluation in centipawns, positive values favor white.
+int evaluate_board(const board_component_t *board);
+
+// Average growth of the tree per completed iteration.
+float effective_branching_factor(const search_stats_t *stats);
+
+// Frees the search buffers of the calling thread and the transposition
+// table, the next search starts with a new table. No other thread may be
+// searching.
+void release_search_memory(void);
@@ -0,0 +1,322 @@
+#include "simulation.h"
+#include "rules_api.h"
+#include "board_snapshot.h"
+#include "foundation/log.h"
+#include "monotonic_clock.h"
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+
+// Bounded queue of fixed size cells. Each cell starts with a sequence
+// number telling whether it is free for the producer claiming position `n`
+// (sequence == n) or holds data for the consumer (sequence == n + 1), so
+// producers only contend on `tail` and never on the data.
+typedef struct sim_queue_t {
+    uint8_t *cells;
+    size_t cell_size;
+    size_t data_size;
+    _Atomic uint64_t tail;
+    uint8_t padding[64 - sizeof(uint64_t)];
+    // Single consumer
+    uint64_t head;
+} sim_queue_t;
+
+enum {
+    // Data follows the sequence number
+    CELL_HEADER_SIZE = 8,
+};
+
+static struct {
+    pthread_t thread;
+    sem_t wake;
+    _Atomic bool running;
+    sim_queue_t commands;
+    sim_queue_t results;
+} sim;
+
+static inline _Atomic uint64_t *cell_sequence(sim_queue_t *q, uint64_t pos)
+{
+    return (_Atomic uint64_t *)(q->cells + (pos & (SIM_QUEUE_CAPACITY - 1)) * q->cell_size);
+}
+
+static inline void *cell_data(sim_queue_t *q, uint64_t pos)
+{
+    return q->cells + (pos & (SIM_QUEUE_CAPACITY - 1)) * q->cell_size + CELL_HEADER_SIZE;
+}
+
+static bool init_queue(sim_queue_t *q, size_t data_size)
+{
+    q->data_size = data_size;
+    q->cell_size = (CELL_HEADER_SIZE + data_size + 63) & ~(size_t)63;
+    q->cells = aligned_alloc(64, q->cell_size * SIM_QUEUE_CAPACITY);
+    if (!q->cells)
+        return false;
+    for (uint64_t i = 0; i < SIM_QUEUE_CAPACITY; ++i)
+        atomic_init(cell_sequence(q, i), i);
+    atomic_init(&q->tail, 0);
+    q->head = 0;
+    return true;
+}
+
+static void free_queue(sim_queue_t *q)
+{
+    free(q->cells);
+    q->cells = 0;
+}
+
+static bool queue_push(sim_queue_t *q, const void *data)
+{
+    uint64_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    for (;;) {
+        const uint64_t sequence = atomic_load_explicit(cell_sequence(q, pos), memory_order_acquire);
+        const int64_t diff = (int64_t)(sequence - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0) {
+            // The consumer hasn't freed this cell yet
+            return false;
+        }
+        else {
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        }
+    }
+
+    memcpy(cell_data(q, pos), data, q->data_size);
+    atomic_store_explicit(cell_sequence(q, pos), pos + 1, memory_order_release);
+    return true;
+}
+
+static bool queue_pop(sim_queue_t *q, void *data)
+{
+    const uint64_t pos = q->head;
+    if (atomic_load_explicit(cell_sequence(q, pos), memory_order_acquire) != pos + 1)
+        return false;
+
+    memcpy(data, cell_data(q, pos), q->data_size);
+    atomic_store_explicit(cell_sequence(q, pos), pos + SIM_QUEUE_CAPACITY, memory_order_release);
+    q->head = pos + 1;
+    return true;
+}
+
+// Moves a validated move; `legal` receives the moves of the next player
+static void play_move(entity_t board_entity, board_component_t *board, clock_component_t *clock, int from, int to, uint64_t now_ns, move_event_t *event, move_t *legal, uint32_t *num_legal)
+{
+    const uint8_t piece_mask = board->indices[from];
+    if (clock)
+        rules_api->press_clock(clock, now_ns);
+
+    const move_info_t info = rules_api->perform_move(board, from, to);
+    *num_legal = rules_api->check_end_condition_with_moves(board, clock, legal);
+    if (clock && board->game_state != STATE_PLAYING)
+        clock->running = false;
+
+    *event = (move_event_t) {
+        .type = MOVE_EVENT_MOVE,
+        .board = board_entity,
+        .piece = piece_mask,
+        .from = (uint8_t)from,
+        .to = (uint8_t)to,
+        .capture = info.capture,
+        .capture_pos = (uint8_t)info.capture_pos,
+        .rook_pos = (uint8_t)info.rook_pos,
+        .promotion = info.promotion,
+        .game_state = board->game_state,
+        .move_count = board->move_count,
+    };
+    if (info.move_type == MOVE_TYPE_CASTLE)
+        event->type = MOVE_EVENT_CASTLE;
+    else if (info.move_type == MOVE_TYPE_CAPTURE)
+        event->type = info.capture_pos != to ? MOVE_EVENT_EN_PASSANT : MOVE_EVENT_CAPTURE;
+}
+
+static bool is_listed_move(const move_t *moves, uint32_t num_moves, int from, int to)
+{
+    for (uint32_t i = 0; i < num_moves; ++i) {
+        if (moves[i].from == from && moves[i].to == to)
+            return true;
+    }
+    return false;
+}
+
+bool simulate_move(entity_t board_entity, board_component_t *board, clock_component_t *clock, int from, int to, uint64_t now_ns, sim_moves_t *moves)
+{
+    if (!(rules_api->is_legal_move(board, from, to) && !rules_api->is_checked_after_move(board, from, to)))
+        return false;
+
+    *moves = (sim_moves_t) { 0 };
+    moves->num_events = 1;
+
+    // The flag may have fallen since clocks were last updated
+    if (clock && clock->running && clock_remaining_ns(clock, clock->running_player, now_ns) == 0) {
+        clock->flagged = true;
+        clock->running = false;
+        rules_api->check_end_condition_reached(board, clock);
+        moves->events[0] = (move_event_t) {
+            .type = MOVE_EVENT_GAME_END,
+            .board = board_entity,
+            .game_state = board->game_state,
+            .move_count = board->move_count,
+        };
+        return true;
+    }
+
+    move_t legal[MAX_MOVES];
+    uint32_t num_legal;
+    play_move(board_entity, board, clock, from, to, now_ns, &moves->events[0], legal, &num_legal);
+
+    // The premove is checked against the moves the end of game check found,
+    // no extra scan of the board
+    if (board->has_premove && board->premove_player == board->current_player) {
+        board->has_premove = false;
+        moves->premove_tried = true;
+        moves->opponent_move_ns = time_now_ns();
+        if (is_listed_move(legal, num_legal, board->premove_from, board->premove_to)) {
+            play_move(board_entity, board, clock, board->premove_from, board->premove_to, moves->opponent_move_ns, &moves->events[1], legal, &num_legal);
+            moves->num_events = 2;
+            moves->premove_applied = true;
+        }
+    }
+    return true;
+}
+
+bool simulate_search(entity_t board_entity, board_component_t *board, clock_component_t *clock, const search_params_t *params, search_result_t *search, sim_moves_t *moves)
+{
+    search_params_t timed = *params;
+    if (clock) {
+        // Zero would mean untimed, an empty clock still gets a move
+        const uint64_t remaining_ms = clock_remaining_ns(clock, board->current_player, time_now_ns()) / 1000000;
+        timed.time.remaining_ms = remaining_ms > 0 ? (uint32_t)remaining_ms : 1;
+        timed.time.increment_ms = (uint32_t)(clock->increment_ns / 1000000);
+    }
+
+    *search = rules_api->search_best_move(board, &timed);
+    if (!search->has_move)
+        return false;
+    return simulate_move(board_entity, board, clock, search->best_move.from, search->best_move.to, time_now_ns(), moves);
+}
+
+static void run_command(const sim_command_t *command, sim_result_t *result)
+{
+    *result = (sim_result_t) {
+        .board_entity = command->board_entity,
+        .has_clock = command->has_clock,
+        .clock = command->clock,
+        .board = command->board,
+    };
+    clock_component_t *clock = command->has_clock ? &result->clock : 0;
+
+    if (command->type == SIM_COMMAND_MOVE) {
+        simulate_move(command->board_entity, &result->board, clock, command->from, command->to, command->time_ns, &result->moves);
+    }
+    else if (command->type == SIM_COMMAND_SEARCH) {
+        simulate_search(command->board_entity, &result->board, clock, &command->search, &result->search, &result->moves);
+    }
+    else if (command->type == SIM_COMMAND_FLAG) {
+        rules_api->check_end_condition_reached(&result->board, clock);
+        result->moves.num_events = 1;
+        result->moves.events[0] = (move_event_t) {
+            .type = MOVE_EVENT_GAME_END,
+            .board = command->board_entity,
+            .game_state = result->board.game_state,
+            .move_count = result->board.move_count,
+        };
+    }
+    else if (command->type == SIM_COMMAND_PUBLISH) {
+        if (result->board.snapshot)
+            publish_board_snapshot(result->board.snapshot, &result->board);
+        return;
+    }
+    else if (command->type == SIM_COMMAND_DESTROY_SNAPSHOT) {
+        destroy_board_snapshot_slot(command->board.snapshot);
+        return;
+    }
+
+    if (result->moves.num_events > 0 && result->board.snapshot)
+        publish_board_snapshot(result->board.snapshot, &result->board);
+}
+
+static void *simulation_thread(void *arg)
+{
+    (void)arg;
+    sim_command_t command;
+    sim_result_t result;
+    for (;;) {
+        sem_wait(&sim.wake);
+        while (queue_pop(&sim.commands, &command)) {
+            if (command.type == SIM_COMMAND_QUIT) {
+                // Search buffers are per thread, only this one can free them
+                rules_api->release_search_memory();
+                return 0;
+            }
+
+            run_command(&command, &result);
+            // Results are never dropped, the main thread is waiting for them
+            while (!queue_push(&sim.results, &result))
+                sched_yield();
+        }
+    }
+}
+
+bool start_simulation_thread(void)
+{
+    if (atomic_load(&sim.running))
+        return true;
+
+    // Results of a previous run may not have been collected yet, keep them
+    if (!sim.results.cells && !init_queue(&sim.results, sizeof(sim_result_t)))
+        return false;
+    if (!init_queue(&sim.commands, sizeof(sim_command_t)))
+        return false;
+
+    sem_init(&sim.wake, 0, 0);
+    if (pthread_create(&sim.thread, 0, simulation_thread, 0) != 0) {
+        log_print(LOG_ERROR, "Failed to start simulation thread, running rules on the main thread");
+        sem_destroy(&sim.wake);
+        free_queue(&sim.commands);
+        return false;
+    }
+
+    atomic_store(&sim.running, true);
+    return true;
+}
+
+void stop_simulation_thread(void)
+{
+    if (!atomic_load(&sim.running))
+        return;
+
+    // New moves run on the calling thread from here on
+    atomic_store(&sim.running, false);
+
+    const sim_command_t quit = { .type = SIM_COMMAND_QUIT };
+    while (!queue_push(&sim.commands, &quit))
+        sched_yield();
+    sem_post(&sim.wake);
+    pthread_join(sim.thread, 0);
+
+    sem_destroy(&sim.wake);
+    free_queue(&sim.commands);
+}
+
+bool is_simulation_thread_running(void)
+{
+    return atomic_load(&sim.running);
+}
+
+bool push_sim_command(const sim_command_t *command)
+{
+    if (!atomic_load(&sim.running) || !queue_push(&sim.commands, command))
+        return false;
+    sem_post(&sim.wake);
+    return true;
+}
+
+bool pop_sim_result(sim_result_t *result)
+{
+    if (!sim.results.cells)
+        return false;
+    return queue_pop(&sim.results, result);
+}
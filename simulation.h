@@ -0,0 +1,87 @@
+#pragma once
+#include "foundation/basic.h"
+#include "components.h"
+#include "move_events.h"
+#include "search.h"
+
+enum {
+    SIM_COMMAND_MOVE,
+    // The flag fell between moves, `clock` is already marked flagged
+    SIM_COMMAND_FLAG,
+    // The AI to move on `board` searches, its move is played like a
+    // `SIM_COMMAND_MOVE`
+    SIM_COMMAND_SEARCH,
+    // `board` was replaced on the main thread, only its snapshot is published
+    SIM_COMMAND_PUBLISH,
+    // The board is gone, `board.snapshot` is destroyed after its last publish
+    SIM_COMMAND_DESTROY_SNAPSHOT,
+    SIM_COMMAND_QUIT,
+};
+
+enum {
+    // Commands and results in flight, must be a power of two
+    SIM_QUEUE_CAPACITY = 1024,
+    // A move and the premove it unblocked
+    SIM_MAX_EVENTS = 2,
+};
+
+// Outcome of one command, the events are applied in order
+typedef struct sim_moves_t {
+    move_event_t events[SIM_MAX_EVENTS];
+    uint32_t num_events;
+    // The board's premove was tried, the last event is the premove if it was legal
+    bool premove_tried;
+    bool premove_applied;
+    // When the move before the premove was done
+    uint64_t opponent_move_ns;
+} sim_moves_t;
+
+// Carries a copy of the board, so the simulation thread keeps no state of
+// its own. Only one command per board may be in flight.
+typedef struct sim_command_t {
+    uint8_t type;
+    uint8_t from;
+    uint8_t to;
+    bool has_clock;
+    entity_t board_entity;
+    // When the input happened, the clock is pressed at this time
+    uint64_t time_ns;
+    clock_component_t clock;
+    board_component_t board;
+    // `SIM_COMMAND_SEARCH` only, the clock's time is filled in when the search starts
+    search_params_t search;
+} sim_command_t;
+
+typedef struct sim_result_t {
+    entity_t board_entity;
+    bool has_clock;
+    // No events for illegal moves, `board` and `clock` are unchanged then.
+    // `MOVE_EVENT_GAME_END` when the flag fell instead of moving.
+    sim_moves_t moves;
+    clock_component_t clock;
+    board_component_t board;
+    // `SIM_COMMAND_SEARCH` only, the move played is `search.best_move`
+    search_result_t search;
+} sim_result_t;
+
+// Rules part of a move: validates it, runs the clock and the end of game
+// check, then plays the premove of the other side if it's legal in the new
+// position. Returns false and leaves everything untouched if the move is
+// illegal. `clock` is optional.
+bool simulate_move(entity_t board_entity, board_component_t *board, clock_component_t *clock, int from, int to, uint64_t now_ns, sim_moves_t *moves);
+// Searches a move for the player to move on `board` and simulates it. The
+// time left on `clock` is read when the search starts. Returns false if
+// there was nothing to play.
+bool simulate_search(entity_t board_entity, board_component_t *board, clock_component_t *clock, const search_params_t *params, search_result_t *search, sim_moves_t *moves);
+
+// While the thread runs it is the only one publishing board snapshots.
+bool start_simulation_thread(void);
+// Waits for queued commands to finish; their results stay queued. No
+// other thread may push commands while stopping.
+void stop_simulation_thread(void);
+bool is_simulation_thread_running(void);
+
+// Safe from any thread. Returns false when the queue is full.
+bool push_sim_command(const sim_command_t *command);
+// Results in command order, main thread only
+bool pop_sim_result(sim_result_t *result);
@@ -0,0 +1,94 @@
+#include "time_manager.h"
+
+enum {
+    // Expected remaining moves when playing sudden death
+    SUDDEN_DEATH_HORIZON = 30,
+    MAX_MOVES_TO_GO = 50,
+};
+
+static const uint64_t ms_to_ns = 1000000ull;
+
+void time_manager_start(time_manager_t *tm, const time_control_t *tc, uint32_t max_time_ms, uint64_t start_ns)
+{
+    memset(tm, 0, sizeof(*tm));
+    tm->start_ns = start_ns;
+
+    uint64_t soft = UINT64_MAX;
+    uint64_t hard = UINT64_MAX;
+
+    if (tc && tc->remaining_ms) {
+        uint64_t remaining = tc->remaining_ms > tc->move_overhead_ms ? tc->remaining_ms - tc->move_overhead_ms : 1;
+        uint64_t moves_to_go = tc->moves_to_go ? tc->moves_to_go : SUDDEN_DEATH_HORIZON;
+        if (moves_to_go > MAX_MOVES_TO_GO)
+            moves_to_go = MAX_MOVES_TO_GO;
+
+        // Most of the increment can be spent since it is given back after the move
+        soft = remaining / moves_to_go + tc->increment_ms * 3 / 4;
+        // Never risk more than a fraction of the clock on one move
+        hard = soft * 5;
+        if (hard > remaining / 3 + tc->increment_ms)
+            hard = remaining / 3 + tc->increment_ms;
+        if (hard > remaining)
+            hard = remaining;
+        if (soft > hard)
+            soft = hard;
+        tm->timed = true;
+    }
+
+    if (max_time_ms) {
+        if (soft > max_time_ms)
+            soft = max_time_ms;
+        if (hard > max_time_ms)
+            hard = max_time_ms;
+        tm->timed = true;
+    }
+
+    if (tm->timed) {
+        tm->soft_limit_ns = (soft ? soft : 1) * ms_to_ns;
+        tm->hard_limit_ns = (hard ? hard : 1) * ms_to_ns;
+    }
+}
+
+bool time_manager_continue(time_manager_t *tm, move_t best_move, int score, float best_move_share, uint64_t now_ns)
+{
+    float scale = 1.0f;
+
+    if (tm->has_last) {
+        // Older changes matter less
+        tm->best_move_changes *= 0.5f;
+        if (best_move.from != tm->last_best_move.from || best_move.to != tm->last_best_move.to) {
+            tm->best_move_changes += 1.0f;
+            tm->stable_iterations = 0;
+        }
+        else {
+            ++tm->stable_iterations;
+        }
+
+        // Spend more time while the best move keeps changing
+        scale *= 1.0f + tm->best_move_changes * 0.6f;
+
+        // Spend more time when the score drops, something was discovered
+        int drop = tm->last_score - score;
+        if (drop > 0)
+            scale *= 1.0f + (drop > 100 ? 100 : drop) / 100.0f;
+
+        // Stop early when one move has stayed best and takes nearly all the effort
+        if (tm->stable_iterations >= 4 && best_move_share > 0.9f)
+            scale *= 0.4f;
+    }
+
+    tm->has_last = true;
+    tm->last_best_move = best_move;
+    tm->last_score = score;
+
+    if (!tm->timed)
+        return true;
+
+    uint64_t elapsed = now_ns - tm->start_ns;
+    uint64_t budget = (uint64_t)((double)tm->soft_limit_ns * scale);
+    if (budget > tm->hard_limit_ns)
+        budget = tm->hard_limit_ns;
+    // The next iteration usually takes longer than all previous ones
+    // together, don't start one that is likely to be cut off
+    return elapsed < budget / 2;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "foundation/basic.h"
+#include "rules.h"
+
+typedef struct time_control_t {
+    // Clock of the side to move in milliseconds; zero means untimed
+    uint32_t remaining_ms;
+    uint32_t increment_ms;
+    // Moves until the next time control, zero for sudden death
+    uint32_t moves_to_go;
+    // Time lost per move to input, animation and scheduling
+    uint32_t move_overhead_ms;
+} time_control_t;
+
+typedef struct time_manager_t {
+    uint64_t start_ns;
+    // Iterations are not started past the soft limit, scaled by stability
+    uint64_t soft_limit_ns;
+    // The search is aborted at the hard limit
+    uint64_t hard_limit_ns;
+    bool timed;
+
+    // Stability tracking between iterations
+    bool has_last;
+    move_t last_best_move;
+    int last_score;
+    float best_move_changes;
+    uint32_t stable_iterations;
+} time_manager_t;
+
+// Allocates limits from a game clock, a fixed time per move, or both (the
+// smaller wins). Leaves the manager untimed if neither is set.
+void time_manager_start(time_manager_t *tm, const time_control_t *tc, uint32_t max_time_ms, uint64_t start_ns);
+
+// Called after each completed iteration with the root result. `best_move_share`
+// is the fraction of the iteration's nodes spent below the best move. Returns
+// false when the search should stop.
+bool time_manager_continue(time_manager_t *tm, move_t best_move, int score, float best_move_share, uint64_t now_ns);
+
+static inline bool time_manager_hard_limit_reached(const time_manager_t *tm, uint64_t now_ns)
+{
+    return tm->timed && now_ns - tm->start_ns >= tm->hard_limit_ns;
+}
@@ -0,0 +1,364 @@
+// Differential fuzzing of the move generator against the legacy brute force
+// path, `is_legal_move` and `is_checked_after_move` over every pair of
+// squares. The legacy rules are the ones from before the move tables, copied
+// below, so they share no code with the generator but `perform_move`.
+// Positions come from random playouts, see random_positions.h, or from an
+// EPD file. Mismatches are printed with their FEN.
+//
+//   cc -O2 -pthread -I. tools/fuzz_movegen.c random_positions.c fen.c rules_module.c
+//      rules.c search.c time_manager.c transposition_table.c arena.c <engine foundation library>
+//      -o fuzz_movegen
+//   ./fuzz_movegen <count> [seed] [threads] [min plies] [max plies]
+//   ./fuzz_movegen -f corpus.epd [threads]
+//
+// Exits with 1 if any position differs.
+
+#include "random_positions.h"
+#include "rules_api.h"
+#include "fen.h"
+#include "monotonic_clock.h"
+#include <pthread.h>
+#include <unistd.h>
+
+enum {
+    MAX_FUZZ_THREADS = 64,
+    // Mismatches printed per thread, all are counted
+    MAX_REPORTS = 16,
+    MAX_REPORT_LENGTH = 1024,
+};
+
+// Legal moves as one bit per target square, indexed by the origin `x + z * 8`
+typedef struct move_set_t {
+    uint64_t to[64];
+} move_set_t;
+
+typedef struct fuzz_task_t {
+    const random_position_params_t *params;
+    // Positions read from a file, random positions when null
+    const board_component_t *positions;
+    uint64_t begin;
+    uint64_t end;
+
+    uint64_t num_positions;
+    uint64_t num_moves;
+    uint64_t num_mismatches;
+    uint64_t legacy_ns;
+    uint64_t generator_ns;
+    char reports[MAX_REPORTS][MAX_REPORT_LENGTH];
+} fuzz_task_t;
+
+static inline int square_index(int square)
+{
+    return (square & 7) + (square >> 4) * 8;
+}
+
+// Rules as they were before `move_tables.h`, renamed to stay apart from rules.c
+
+static bool legacy_is_legal_move(board_component_t *board, int from, int to)
+{
+    if ((to & 0x88) != 0)
+        return false;
+
+    uint8_t piece_to_move = board->indices[from];
+    if (piece_to_move == 0)
+        return false;
+
+    if ((piece_to_move & MASK_COLOR) != board->current_player)
+        return false;
+
+    uint8_t piece_to_capture = board->indices[to];
+    if (piece_to_capture != 0 && (piece_to_capture & MASK_COLOR) == board->current_player)
+        return false;
+
+    bool can_move = false;
+
+    int diff = abs(from - to);
+    switch (piece_to_move & MASK_TYPE) {
+        case PIECE_PAWN: {
+            int dir = from - to > 0 ? 0 : 8;
+            int row = from & MASK_ROW;
+            if ((piece_to_move & MASK_COLOR) == dir) {
+                can_move |= (diff == 16 && piece_to_capture == 0);
+                can_move |= ((diff == 15 || diff == 17) && piece_to_capture != 0);
+                can_move |= (diff == 32 && (row == 0x60 || row == 0x10) && piece_to_capture == 0 && board->indices[from + (dir != 0 ? 16 : -16)] == 0);
+                if (board->en_passant_pos && piece_to_capture == 0) {
+                    can_move |= (diff == (dir != 0 ? 15 : 17) && (from - 1) == board->en_passant_pos);
+                    can_move |= (diff == (dir != 0 ? 17 : 15) && (from + 1) == board->en_passant_pos);
+                }
+            }
+            break;
+        }
+        case PIECE_KNIGHT: {
+            can_move |= (diff == 14 || diff == 18 || diff == 31 || diff == 33);
+            break;
+        }
+        case PIECE_KING: {
+            int dir = from - to > 0 ? 1 : 0;
+            int rook_from = from + (dir != 0 ? -3 : 4);
+            int rook_to = from + (dir != 0 ? -1 : 1);
+            // Castling move; check castling rights and check if rook move is legal.
+            // The rook may not capture, `revert_move` can't restore such a piece.
+            can_move |= (diff == 2 && (board->castle_bits >> (board->current_player / 4 + dir) & 1) != 0 && board->indices[rook_to] == 0 && legacy_is_legal_move(board, rook_from, rook_to));
+            can_move |= (diff == 1 || diff == 16 || diff == 17 || diff == 15);
+            break;
+        }
+        case PIECE_BISHOP: {
+            can_move |= (diff % 15 == 0 || diff % 17 == 0);
+            break;
+        }
+        case PIECE_ROOK: {
+            can_move |= ((from & 0x0f) == (to & 0x0f) || (from & 0xf0) == (to & 0xf0));
+            break;
+        }
+        case PIECE_QUEEN: {
+            can_move |= (diff % 15 == 0 || diff % 17 == 0 || (from & 0x0f) == (to & 0x0f) || (from & 0xf0) == (to & 0xf0));
+            break;
+        }
+    }
+
+    if (can_move && (piece_to_move & MASK_SLIDE)) {
+        int dir = to - from;
+        int step = 0;
+        if (dir % 17 == 0) step = 17;
+        else if (dir % 15 == 0) step = 15;
+        else if (dir % 16 == 0) step = 16;
+        else step = 1;
+
+        step = (dir / step < 0) ? -step : step;
+
+        int path = from + step;
+        for (int i = 1; i < (to - from) / step; ++i, path += step) {
+            can_move &= board->indices[path] == 0;
+        }
+    }
+
+    return can_move;
+}
+
+static bool legacy_is_piece_attacked(board_component_t *board, uint8_t piece)
+{
+    // Find piece position
+    int pos = 0;
+    for (int i = 0; i < 128; ++i) {
+        if (board->indices[i] == piece) {
+            pos = i;
+            break;
+        }
+    }
+
+    // Check if any piece can attack `pos`
+    bool attacked = false;
+    for (int i = 0; i < 128; ++i) {
+        if (legacy_is_legal_move(board, i, pos)) {
+            attacked = true;
+            break;
+        }
+    }
+
+    return attacked;
+}
+
+static bool legacy_is_checked_after_move(board_component_t *board, int from, int to)
+{
+    move_info_t info = rules_api->perform_move(board, from, to);
+
+    const uint8_t king_piece = PIECE_KING | (board->current_player == PIECE_WHITE ? PIECE_BLACK : PIECE_WHITE);
+    bool checked = legacy_is_piece_attacked(board, king_piece);
+    rules_api->revert_move(board, from, to, &info);
+
+    return checked;
+}
+
+static void legacy_moves(board_component_t *board, move_set_t *set)
+{
+    memset(set, 0, sizeof(*set));
+    for (int from = 0; from < 128; ++from) {
+        if ((from & 0x88) || board->indices[from] == 0 || (board->indices[from] & MASK_COLOR) != board->current_player)
+            continue;
+        for (int i = 0; i < 64; ++i) {
+            const int to = (i % 8) + (i / 8) * 16;
+            if (legacy_is_legal_move(board, from, to) && !legacy_is_checked_after_move(board, from, to))
+                set->to[square_index(from)] |= 1ULL << i;
+        }
+    }
+}
+
+static uint32_t generator_moves(board_component_t *board, move_set_t *set)
+{
+    move_t moves[MAX_MOVES];
+    const uint32_t n = rules_api->generate_legal_moves(board, moves);
+    memset(set, 0, sizeof(*set));
+    for (uint32_t i = 0; i < n; ++i)
+        set->to[square_index(moves[i].from)] |= 1ULL << square_index(moves[i].to);
+    return n;
+}
+
+// Appends the moves in `a` missing from `b` as UCI
+static char *print_difference(char *s, const char *end, const move_set_t *a, const move_set_t *b)
+{
+    for (int from = 0; from < 64; ++from) {
+        for (uint64_t bits = a->to[from] & ~b->to[from]; bits && end - s > 6; bits &= bits - 1) {
+            const int to = __builtin_ctzll(bits);
+            *s++ = ' ';
+            format_square((from % 8) + (from / 8) * 16, s);
+            format_square((to % 8) + (to / 8) * 16, s + 2);
+            s += 4;
+        }
+    }
+    return s;
+}
+
+static void report_mismatch(fuzz_task_t *task, const board_component_t *board, uint64_t index, const move_set_t *legacy, const move_set_t *generator)
+{
+    if (task->num_mismatches++ >= MAX_REPORTS)
+        return;
+
+    char *s = task->reports[task->num_mismatches - 1];
+    const char *end = s + MAX_REPORT_LENGTH - 1;
+    s += sprintf(s, "position %llu: ", (unsigned long long)index);
+    s += format_fen(board, s, true);
+    s += sprintf(s, "\n  legacy only:");
+    s = print_difference(s, end - 32, legacy, generator);
+    s += sprintf(s, "\n  generator only:");
+    s = print_difference(s, end, generator, legacy);
+    *s = 0;
+}
+
+static void *fuzz_thread(void *data)
+{
+    fuzz_task_t *task = data;
+    board_component_t board = { .selected_piece = { .id = UINT64_MAX } };
+    random_position_stats_t stats = { 0 };
+    move_set_t legacy;
+    move_set_t generator;
+    for (uint64_t i = task->begin; i < task->end; ++i) {
+        if (task->positions)
+            board = task->positions[i];
+        else
+            random_position(task->params, i, &board, &stats);
+
+        uint64_t start = time_now_ns();
+        legacy_moves(&board, &legacy);
+        task->legacy_ns += time_now_ns() - start;
+
+        start = time_now_ns();
+        task->num_moves += generator_moves(&board, &generator);
+        task->generator_ns += time_now_ns() - start;
+
+        if (memcmp(&legacy, &generator, sizeof(move_set_t)) != 0)
+            report_mismatch(task, &board, i, &legacy, &generator);
+        ++task->num_positions;
+    }
+    return 0;
+}
+
+static board_component_t *read_epd(const char *path, uint64_t *num_positions)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+
+    board_component_t *positions = 0;
+    uint64_t n = 0;
+    uint64_t capacity = 0;
+    char line[1024];
+    for (uint64_t line_number = 1; fgets(line, sizeof(line), f); ++line_number) {
+        if (n == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            board_component_t *grown = realloc(positions, capacity * sizeof(board_component_t));
+            if (!grown)
+                break;
+            positions = grown;
+        }
+        board_component_t *board = &positions[n];
+        memset(board, 0, sizeof(*board));
+        board->selected_piece.id = UINT64_MAX;
+        // EPD opcodes follow the four position fields and are ignored
+        if (parse_fen(line, strcspn(line, ";\r\n"), board))
+            ++n;
+        else if (line[0] != '\n' && line[0] != '#')
+            fprintf(stderr, "%s:%llu: invalid position\n", path, (unsigned long long)line_number);
+    }
+    fclose(f);
+    *num_positions = n;
+    return positions;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <count> [seed] [threads] [min plies] [max plies]\n       %s -f <corpus.epd> [threads]\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    const long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const bool from_file = strcmp(argv[1], "-f") == 0 && argc > 2;
+    // The thread count is the third argument in both forms
+    const int threads_arg = 3;
+    random_position_params_t params = {
+        .seed = !from_file && argc > 2 ? strtoull(argv[2], 0, 0) : 1,
+        .min_plies = !from_file && argc > 4 ? (uint32_t)strtoul(argv[4], 0, 10) : 0,
+        .max_plies = !from_file && argc > 5 ? (uint32_t)strtoul(argv[5], 0, 10) : 120,
+    };
+    uint32_t num_threads = argc > threads_arg ? (uint32_t)strtoul(argv[threads_arg], 0, 10) : (uint32_t)(num_cpus > 0 ? num_cpus : 1);
+    if (num_threads == 0 || num_threads > MAX_FUZZ_THREADS)
+        num_threads = num_threads ? MAX_FUZZ_THREADS : 1;
+
+    board_component_t *positions = 0;
+    uint64_t num_positions = 0;
+    if (from_file) {
+        positions = read_epd(argv[2], &num_positions);
+        if (!positions)
+            return 1;
+    }
+    else
+        num_positions = strtoull(argv[1], 0, 10);
+
+    static fuzz_task_t tasks[MAX_FUZZ_THREADS];
+    pthread_t threads[MAX_FUZZ_THREADS];
+    bool started[MAX_FUZZ_THREADS] = { 0 };
+    for (uint32_t t = 0; t < num_threads; ++t) {
+        tasks[t].params = &params;
+        tasks[t].positions = positions;
+        tasks[t].begin = num_positions * t / num_threads;
+        tasks[t].end = num_positions * (t + 1) / num_threads;
+    }
+
+    const uint64_t start = time_now_ns();
+    for (uint32_t t = 1; t < num_threads; ++t)
+        started[t] = pthread_create(&threads[t], 0, fuzz_thread, &tasks[t]) == 0;
+    fuzz_thread(&tasks[0]);
+    for (uint32_t t = 1; t < num_threads; ++t) {
+        if (started[t])
+            pthread_join(threads[t], 0);
+        else
+            fuzz_thread(&tasks[t]);
+    }
+    const double seconds = (time_now_ns() - start) / 1e9;
+
+    fuzz_task_t total = { 0 };
+    for (uint32_t t = 0; t < num_threads; ++t) {
+        const fuzz_task_t *task = &tasks[t];
+        for (uint64_t r = 0; r < task->num_mismatches && r < MAX_REPORTS; ++r)
+            printf("%s\n", task->reports[r]);
+        total.num_positions += task->num_positions;
+        total.num_moves += task->num_moves;
+        total.num_mismatches += task->num_mismatches;
+        total.legacy_ns += task->legacy_ns;
+        total.generator_ns += task->generator_ns;
+    }
+    free(positions);
+
+    // Per thread time, summed over the threads
+    const double legacy_s = total.legacy_ns / 1e9;
+    const double generator_s = total.generator_ns / 1e9;
+    printf("%llu positions, %llu legal moves, %llu mismatches on %u threads in %.2f s\n",
+        (unsigned long long)total.num_positions, (unsigned long long)total.num_moves,
+        (unsigned long long)total.num_mismatches, num_threads, seconds);
+    printf("legacy %.0f positions/s, generator %.0f positions/s per thread, generator %.1fx faster\n",
+        total.num_positions / (legacy_s > 0 ? legacy_s : 1e-9), total.num_positions / (generator_s > 0 ? generator_s : 1e-9),
+        legacy_s / (generator_s > 0 ? generator_s : 1e-9));
+    return total.num_mismatches ? 1 : 0;
+}
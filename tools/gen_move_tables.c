@@ -0,0 +1,136 @@
+// Generates move_tables.h, the constant 0x88 geometry tables used by rules.c.
+//
+//   cc tools/gen_move_tables.c -o gen_move_tables && ./gen_move_tables > move_tables.h
+
+#include <stdio.h>
+#include <stdlib.h>
+
+enum {
+    // Must match chess.h
+    PIECE_WHITE = 0x0,
+    PIECE_BLACK = 0x8,
+
+    ATTACK_WHITE_PAWN = 0x01,
+    ATTACK_BLACK_PAWN = 0x02,
+    ATTACK_KNIGHT = 0x04,
+    ATTACK_KING = 0x08,
+    ATTACK_DIAGONAL = 0x10,
+    ATTACK_STRAIGHT = 0x20,
+
+    // Difference `to - from` of two squares is stored at `diff + DIFF_OFFSET`
+    DIFF_OFFSET = 119,
+    NUM_DIFFS = 240,
+};
+
+static const int knight_offsets[8] = { -33, -31, -18, -14, 14, 18, 31, 33 };
+static const int king_offsets[8] = { -17, -16, -15, -1, 1, 15, 16, 17 };
+static const int diagonal_steps[4] = { -17, -15, 15, 17 };
+static const int straight_steps[4] = { -16, -1, 1, 16 };
+
+static void print_int_table(const char *type, const char *name, const int *values, int n, int per_line)
+{
+    printf("static const %s %s[%i] = {", type, name, n);
+    for (int i = 0; i < n; ++i) {
+        if (i % per_line == 0)
+            printf("\n   ");
+        printf(" %i,", values[i]);
+    }
+    printf("\n};\n\n");
+}
+
+int main(void)
+{
+    int attacks[NUM_DIFFS] = { 0 };
+    int directions[NUM_DIFFS] = { 0 };
+
+    // Walk every pair of valid squares so only reachable differences are set
+    for (int from = 0; from < 128; ++from) {
+        if (from & 0x88)
+            continue;
+        for (int i = 0; i < 8; ++i) {
+            int to = from + knight_offsets[i];
+            if (!(to & 0x88))
+                attacks[to - from + DIFF_OFFSET] |= ATTACK_KNIGHT;
+            to = from + king_offsets[i];
+            if (!(to & 0x88))
+                attacks[to - from + DIFF_OFFSET] |= ATTACK_KING;
+        }
+        for (int i = 0; i < 4; ++i) {
+            for (int to = from + diagonal_steps[i]; !(to & 0x88); to += diagonal_steps[i]) {
+                attacks[to - from + DIFF_OFFSET] |= ATTACK_DIAGONAL;
+                directions[to - from + DIFF_OFFSET] = diagonal_steps[i];
+            }
+            for (int to = from + straight_steps[i]; !(to & 0x88); to += straight_steps[i]) {
+                attacks[to - from + DIFF_OFFSET] |= ATTACK_STRAIGHT;
+                directions[to - from + DIFF_OFFSET] = straight_steps[i];
+            }
+        }
+    }
+    // White moves towards lower rows
+    attacks[-15 + DIFF_OFFSET] |= ATTACK_WHITE_PAWN;
+    attacks[-17 + DIFF_OFFSET] |= ATTACK_WHITE_PAWN;
+    attacks[15 + DIFF_OFFSET] |= ATTACK_BLACK_PAWN;
+    attacks[17 + DIFF_OFFSET] |= ATTACK_BLACK_PAWN;
+
+    // Castling, indexed by castle bit `player / 4 + dir` where `dir` is 1
+    // when the king moves towards column 0
+    int king_from[4], king_to[4], rook_from[4], rook_to[4], path_mask[4];
+    for (int bit = 0; bit < 4; ++bit) {
+        int row = bit < 2 ? 0x70 : 0x00;
+        int dir = bit & 1;
+        king_from[bit] = row + 3;
+        king_to[bit] = king_from[bit] + (dir ? -2 : 2);
+        rook_from[bit] = king_from[bit] + (dir ? -3 : 4);
+        rook_to[bit] = king_from[bit] + (dir ? -1 : 1);
+        // Columns between king and rook, which must all be empty
+        int lo = (dir ? rook_from[bit] : king_from[bit]) & 0x7;
+        int hi = (dir ? king_from[bit] : rook_from[bit]) & 0x7;
+        path_mask[bit] = 0;
+        for (int x = lo + 1; x < hi; ++x)
+            path_mask[bit] |= 1 << x;
+    }
+
+    int piece_attacks[16] = { 0 };
+    for (int color = 0; color < 16; color += 8) {
+        piece_attacks[color | 0x1] = color == PIECE_WHITE ? ATTACK_WHITE_PAWN : ATTACK_BLACK_PAWN;
+        piece_attacks[color | 0x2] = ATTACK_KNIGHT;
+        piece_attacks[color | 0x3] = ATTACK_KING;
+        piece_attacks[color | 0x5] = ATTACK_DIAGONAL;
+        piece_attacks[color | 0x6] = ATTACK_STRAIGHT;
+        piece_attacks[color | 0x7] = ATTACK_DIAGONAL | ATTACK_STRAIGHT;
+    }
+
+    printf("#pragma once\n");
+    printf("// Generated by tools/gen_move_tables.c, do not edit.\n\n");
+    printf("enum {\n");
+    printf("    ATTACK_WHITE_PAWN = 0x%02x,\n", ATTACK_WHITE_PAWN);
+    printf("    ATTACK_BLACK_PAWN = 0x%02x,\n", ATTACK_BLACK_PAWN);
+    printf("    ATTACK_KNIGHT = 0x%02x,\n", ATTACK_KNIGHT);
+    printf("    ATTACK_KING = 0x%02x,\n", ATTACK_KING);
+    printf("    ATTACK_DIAGONAL = 0x%02x,\n", ATTACK_DIAGONAL);
+    printf("    ATTACK_STRAIGHT = 0x%02x,\n", ATTACK_STRAIGHT);
+    printf("    // Difference `to - from` of two squares is looked up at `diff + DIFF_OFFSET`\n");
+    printf("    DIFF_OFFSET = %i,\n", DIFF_OFFSET);
+    printf("};\n\n");
+
+    print_int_table("int8_t", "knight_offsets", knight_offsets, 8, 8);
+    print_int_table("int8_t", "king_offsets", king_offsets, 8, 8);
+    print_int_table("int8_t", "diagonal_steps", diagonal_steps, 4, 4);
+    print_int_table("int8_t", "straight_steps", straight_steps, 4, 4);
+
+    printf("// Which moves can reach a square difference, see `ATTACK_KNIGHT`\n");
+    print_int_table("uint8_t", "attack_by_diff", attacks, NUM_DIFFS, 16);
+    printf("// Sliding step along a square difference, zero if not on a line\n");
+    print_int_table("int8_t", "direction_by_diff", directions, NUM_DIFFS, 16);
+    printf("// Attack bits of each piece mask\n");
+    print_int_table("uint8_t", "piece_attacks", piece_attacks, 16, 8);
+
+    printf("// Castling, indexed by castle bit\n");
+    print_int_table("uint8_t", "castle_king_from", king_from, 4, 4);
+    print_int_table("uint8_t", "castle_king_to", king_to, 4, 4);
+    print_int_table("uint8_t", "castle_rook_from", rook_from, 4, 4);
+    print_int_table("uint8_t", "castle_rook_to", rook_to, 4, 4);
+    printf("// Columns between king and rook that must be empty\n");
+    print_int_table("uint8_t", "castle_path_mask", path_mask, 4, 4);
+    return 0;
+}
@@ -0,0 +1,50 @@
+// Writes random reachable positions as an EPD corpus, see random_positions.h.
+//
+//   cc -O2 -pthread -I. tools/gen_positions.c random_positions.c fen.c rules_module.c
+//      rules.c search.c time_manager.c transposition_table.c arena.c <engine foundation library>
+//      -o gen_positions
+//   ./gen_positions <count> <min plies> <max plies> [seed] [threads] [out.epd]
+//
+// Without an output file only the playouts are timed.
+
+#include "random_positions.h"
+#include "monotonic_clock.h"
+#include <unistd.h>
+
+int main(int argc, char **argv)
+{
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s <count> <min plies> <max plies> [seed] [threads] [out.epd]\n", argv[0]);
+        return 1;
+    }
+
+    const long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const random_position_params_t params = {
+        .num_positions = strtoull(argv[1], 0, 10),
+        .min_plies = (uint32_t)strtoul(argv[2], 0, 10),
+        .max_plies = (uint32_t)strtoul(argv[3], 0, 10),
+        .seed = argc > 4 ? strtoull(argv[4], 0, 0) : 1,
+        .num_threads = argc > 5 ? (uint32_t)strtoul(argv[5], 0, 10) : (uint32_t)(num_cpus > 0 ? num_cpus : 1),
+    };
+
+    FILE *out = 0;
+    if (argc > 6) {
+        out = strcmp(argv[6], "-") == 0 ? stdout : fopen(argv[6], "w");
+        if (!out) {
+            perror(argv[6]);
+            return 1;
+        }
+    }
+
+    const random_position_stats_t stats = write_random_positions(&params, out);
+    if (out && (fflush(out) != 0 || ferror(out) || (out != stdout && fclose(out) != 0))) {
+        fprintf(stderr, "failed to write %s\n", argv[6]);
+        return 1;
+    }
+
+    const double seconds = stats.elapsed_ns / 1e9;
+    fprintf(stderr, "%llu positions on %u threads in %.2f s: %.2f M playouts/s, %.1f M plies/s, %llu replayed\n",
+        (unsigned long long)stats.num_positions, params.num_threads, seconds,
+        stats.num_positions / seconds / 1e6, stats.num_plies / seconds / 1e6, (unsigned long long)stats.num_retries);
+    return 0;
+}
@@ -0,0 +1,185 @@
+// Builds the rating sorted index of a puzzle CSV, see puzzles.h.
+//
+//   cc -O2 tools/index_puzzles.c -o index_puzzles && ./index_puzzles lichess_db_puzzle.csv puzzles.idx
+//
+// The columns are taken from a header line naming "FEN", "Moves" and
+// "Rating", without one the Lichess layout is assumed. Puzzles the game
+// can't play are left out: underpromotions, since the rules always promote
+// to a queen, and solutions longer than PUZZLE_MAX_MOVES.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+enum {
+    // Must match puzzles.h and components.h
+    PUZZLE_INDEX_MAGIC = 0x58495a50,
+    PUZZLE_INDEX_VERSION = 1,
+    PUZZLE_MAX_MOVES = 32,
+};
+
+typedef struct puzzle_index_header_t {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t num_puzzles;
+    uint64_t csv_size;
+    uint32_t fen_column;
+    uint32_t moves_column;
+    uint32_t rating_column;
+    uint32_t padding;
+} puzzle_index_header_t;
+
+typedef struct puzzle_index_entry_t {
+    uint64_t offset;
+    uint32_t length;
+    uint16_t rating;
+    uint16_t num_moves;
+} puzzle_index_entry_t;
+
+// Start and length of zero based column `column`, -1 if the line is shorter
+static int find_column(const char *line, size_t length, uint32_t column, size_t *field_length)
+{
+    size_t start = 0;
+    for (uint32_t i = 0; i < column; ++i) {
+        const char *comma = memchr(line + start, ',', length - start);
+        if (!comma)
+            return -1;
+        start = (size_t)(comma - line) + 1;
+    }
+    const char *comma = memchr(line + start, ',', length - start);
+    size_t end = comma ? (size_t)(comma - line) : length;
+    while (end > start && (line[end - 1] == '\n' || line[end - 1] == '\r'))
+        --end;
+    *field_length = end - start;
+    return (int)start;
+}
+
+// Number of moves, zero if any of them can't be played by the game
+static uint32_t count_moves(const char *moves, size_t length)
+{
+    uint32_t num_moves = 0;
+    size_t i = 0;
+    while (i < length) {
+        while (i < length && moves[i] == ' ')
+            ++i;
+        size_t n = 0;
+        while (i + n < length && moves[i + n] != ' ')
+            ++n;
+        if (n == 0)
+            break;
+        if ((n != 4 && n != 5) || (n == 5 && moves[i + 4] != 'q') || ++num_moves > PUZZLE_MAX_MOVES)
+            return 0;
+        i += n;
+    }
+    return num_moves;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    const puzzle_index_entry_t *x = a;
+    const puzzle_index_entry_t *y = b;
+    if (x->rating != y->rating)
+        return x->rating < y->rating ? -1 : 1;
+    return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <puzzles.csv> <index>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *csv = fopen(argv[1], "rb");
+    if (!csv) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    // Lichess: PuzzleId,FEN,Moves,Rating,...
+    puzzle_index_header_t header = {
+        .magic = PUZZLE_INDEX_MAGIC,
+        .version = PUZZLE_INDEX_VERSION,
+        .fen_column = 1,
+        .moves_column = 2,
+        .rating_column = 3,
+    };
+
+    puzzle_index_entry_t *entries = 0;
+    size_t num_entries = 0;
+    size_t capacity = 0;
+    uint64_t num_skipped = 0;
+    uint64_t offset = 0;
+    char *line = 0;
+    size_t line_capacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &line_capacity, csv)) > 0) {
+        const uint64_t line_offset = offset;
+        offset += (uint64_t)length;
+
+        if (line_offset == 0 && strstr(line, "FEN") && strstr(line, "Moves")) {
+            uint32_t column = 0;
+            for (char *name = strtok(line, ",\r\n"); name; name = strtok(0, ",\r\n"), ++column) {
+                if (strcmp(name, "FEN") == 0)
+                    header.fen_column = column;
+                else if (strcmp(name, "Moves") == 0)
+                    header.moves_column = column;
+                else if (strcmp(name, "Rating") == 0)
+                    header.rating_column = column;
+            }
+            continue;
+        }
+
+        size_t fen_length, moves_length, rating_length;
+        const int fen = find_column(line, (size_t)length, header.fen_column, &fen_length);
+        const int moves = find_column(line, (size_t)length, header.moves_column, &moves_length);
+        const int rating = find_column(line, (size_t)length, header.rating_column, &rating_length);
+        const uint32_t num_moves = moves < 0 ? 0 : count_moves(line + moves, moves_length);
+        if (fen < 0 || fen_length == 0 || rating < 0 || rating_length == 0 || num_moves < 2 || (uint64_t)length > UINT32_MAX) {
+            ++num_skipped;
+            continue;
+        }
+
+        if (num_entries == capacity) {
+            capacity = capacity ? capacity * 2 : 1 << 16;
+            entries = realloc(entries, capacity * sizeof(puzzle_index_entry_t));
+            if (!entries) {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+            }
+        }
+        const long r = strtol(line + rating, 0, 10);
+        entries[num_entries++] = (puzzle_index_entry_t) {
+            .offset = line_offset,
+            .length = (uint32_t)length,
+            .rating = (uint16_t)(r < 0 ? 0 : r > UINT16_MAX ? UINT16_MAX : r),
+            .num_moves = (uint16_t)num_moves,
+        };
+    }
+    free(line);
+    fclose(csv);
+
+    qsort(entries, num_entries, sizeof(puzzle_index_entry_t), compare_entries);
+    header.num_puzzles = num_entries;
+    header.csv_size = offset;
+
+    FILE *out = fopen(argv[2], "wb");
+    if (!out) {
+        perror(argv[2]);
+        return 1;
+    }
+    const int ok = fwrite(&header, sizeof(header), 1, out) == 1
+        && fwrite(entries, sizeof(puzzle_index_entry_t), num_entries, out) == num_entries;
+    if (fclose(out) != 0 || !ok) {
+        fprintf(stderr, "failed to write %s\n", argv[2]);
+        return 1;
+    }
+
+    fprintf(stderr, "%zu puzzles indexed, %llu skipped", num_entries, (unsigned long long)num_skipped);
+    if (num_entries)
+        fprintf(stderr, ", ratings %u to %u", entries[0].rating, entries[num_entries - 1].rating);
+    fprintf(stderr, "\n");
+    free(entries);
+    return 0;
+}
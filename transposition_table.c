@@ -0,0 +1,324 @@
+#include "transposition_table.h"
+#include "foundation/log.h"
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+enum {
+    ENTRIES_PER_BUCKET = 4,
+    // Buckets start after the header, one cache line in
+    HEADER_SIZE = 64,
+    GENERATION_MASK = 0x3f,
+};
+
+// Changes whenever the header or entry layout does
+static const uint64_t tt_magic = 0x63687474626c0001ull;
+
+// Both words are written separately without locking. The check word holds the
+// key xor the data word, so an entry torn by a concurrent writer (any thread
+// or process) fails verification and is treated as a miss.
+typedef struct tt_entry_t {
+    _Atomic uint64_t check;
+    _Atomic uint64_t data;
+} tt_entry_t;
+
+typedef struct tt_bucket_t {
+    tt_entry_t entries[ENTRIES_PER_BUCKET];
+} tt_bucket_t;
+
+// Shared between processes when the table lives in shared memory
+typedef struct tt_header_t {
+    _Atomic uint64_t magic;
+    uint64_t num_buckets;
+    _Atomic uint32_t num_attached;
+    _Atomic uint32_t next_owner;
+    _Atomic uint32_t generation;
+} tt_header_t;
+
+static struct {
+    tt_header_t *header;
+    tt_bucket_t *buckets;
+    uint64_t bucket_mask;
+    size_t mapped_size;
+    bool shared;
+    char shared_name[64];
+    // Tags entries stored by this process
+    uint16_t owner;
+} tt;
+
+// Entry data layout:
+//   bits  0-7   from
+//   bits  8-15  to
+//   bits 16-31  score
+//   bits 32-39  depth
+//   bits 40-41  bound
+//   bits 42-47  generation
+//   bits 48-63  owner
+static inline uint64_t pack_entry(move_t move, int score, int depth, uint8_t bound, uint32_t generation, uint16_t owner)
+{
+    return (uint64_t)move.from
+        | (uint64_t)move.to << 8
+        | (uint64_t)(uint16_t)(int16_t)score << 16
+        | (uint64_t)(uint8_t)(depth < 0 ? 0 : depth > 255 ? 255 : depth) << 32
+        | (uint64_t)(bound & 0x3) << 40
+        | (uint64_t)(generation & GENERATION_MASK) << 42
+        | (uint64_t)owner << 48;
+}
+
+static inline uint8_t entry_depth(uint64_t data) { return (uint8_t)(data >> 32); }
+static inline uint8_t entry_bound(uint64_t data) { return (uint8_t)((data >> 40) & 0x3); }
+static inline uint32_t entry_generation(uint64_t data) { return (uint32_t)((data >> 42) & GENERATION_MASK); }
+static inline uint16_t entry_owner(uint64_t data) { return (uint16_t)(data >> 48); }
+
+static uint64_t buckets_for_size(uint32_t size_mb)
+{
+    uint64_t bytes = (uint64_t)(size_mb ? size_mb : 1) << 20;
+    uint64_t n = (bytes - HEADER_SIZE) / sizeof(tt_bucket_t);
+    // Round down to a power of two so the key can be masked
+    uint64_t pow2 = 1;
+    while (pow2 * 2 <= n)
+        pow2 *= 2;
+    return pow2;
+}
+
+zobrist_keys_t zobrist;
+
+static inline uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static void init_zobrist_keys(void)
+{
+    // Fixed seed; every process must produce the same keys
+    uint64_t state = 0x636865737333644bull;
+    for (int p = 0; p < 16; ++p)
+        for (int i = 0; i < 128; ++i)
+            zobrist.pieces[p][i] = splitmix64(&state);
+    for (int i = 0; i < 16; ++i)
+        zobrist.castle[i] = splitmix64(&state);
+    for (int i = 0; i < 128; ++i)
+        zobrist.en_passant[i] = splitmix64(&state);
+    zobrist.black_to_move = splitmix64(&state);
+}
+
+static void attach(void *memory, size_t size)
+{
+    tt.header = memory;
+    tt.buckets = (tt_bucket_t *)((uint8_t *)memory + HEADER_SIZE);
+    tt.bucket_mask = tt.header->num_buckets - 1;
+    tt.mapped_size = size;
+    tt.owner = (uint16_t)(atomic_fetch_add(&tt.header->next_owner, 1) + 1);
+    atomic_fetch_add(&tt.header->num_attached, 1);
+    init_zobrist_keys();
+}
+
+bool tt_init(uint32_t size_mb)
+{
+    tt_shutdown();
+
+    uint64_t num_buckets = buckets_for_size(size_mb);
+    size_t size = HEADER_SIZE + num_buckets * sizeof(tt_bucket_t);
+    void *memory = calloc(1, size);
+    if (!memory) {
+        log_print(LOG_ERROR, "Failed to allocate %u MB transposition table", size_mb);
+        return false;
+    }
+
+    tt_header_t *header = memory;
+    header->num_buckets = num_buckets;
+    atomic_store(&header->magic, tt_magic);
+    attach(memory, size);
+    return true;
+}
+
+bool tt_init_shared(const char *name, uint32_t size_mb)
+{
+    tt_shutdown();
+
+    // The first process creates and sizes the segment, the others attach to it
+    bool created = true;
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        created = false;
+        fd = shm_open(name, O_RDWR, 0600);
+    }
+    if (fd < 0) {
+        log_print(LOG_ERROR, "Failed to open shared transposition table '%s'", name);
+        return false;
+    }
+
+    size_t size;
+    if (created) {
+        uint64_t num_buckets = buckets_for_size(size_mb);
+        size = HEADER_SIZE + num_buckets * sizeof(tt_bucket_t);
+        if (ftruncate(fd, (off_t)size) != 0) {
+            log_print(LOG_ERROR, "Failed to size shared transposition table '%s'", name);
+            close(fd);
+            shm_unlink(name);
+            return false;
+        }
+    }
+    else {
+        // Wait for the creator to size the segment
+        struct stat st = { 0 };
+        for (int tries = 0; tries < 1000 && fstat(fd, &st) == 0 && st.st_size == 0; ++tries)
+            usleep(1000);
+        size = (size_t)st.st_size;
+    }
+
+    void *memory = size >= HEADER_SIZE ? mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (memory == MAP_FAILED) {
+        log_print(LOG_ERROR, "Failed to map shared transposition table '%s'", name);
+        return false;
+    }
+
+    tt_header_t *header = memory;
+    if (created) {
+        // The segment is zero filled, publishing the magic makes it usable
+        header->num_buckets = (size - HEADER_SIZE) / sizeof(tt_bucket_t);
+        atomic_store(&header->magic, tt_magic);
+    }
+    else {
+        for (int tries = 0; tries < 1000 && atomic_load(&header->magic) == 0; ++tries)
+            usleep(1000);
+        if (atomic_load(&header->magic) != tt_magic) {
+            log_print(LOG_ERROR, "Shared transposition table '%s' has an incompatible layout", name);
+            munmap(memory, size);
+            return false;
+        }
+    }
+
+    attach(memory, size);
+    tt.shared = true;
+    snprintf(tt.shared_name, sizeof(tt.shared_name), "%s", name);
+    log_print(LOG_INFO, "%s shared transposition table '%s' (%llu MB, %u processes)", created ? "Created" : "Attached to",
+        name, (unsigned long long)(size >> 20), atomic_load(&header->num_attached));
+    return true;
+}
+
+void tt_shutdown(void)
+{
+    if (!tt.header)
+        return;
+
+    if (tt.shared) {
+        bool last = atomic_fetch_sub(&tt.header->num_attached, 1) == 1;
+        munmap(tt.header, tt.mapped_size);
+        if (last)
+            shm_unlink(tt.shared_name);
+    }
+    else {
+        free(tt.header);
+    }
+
+    memset(&tt, 0, sizeof(tt));
+}
+
+bool tt_is_ready(void)
+{
+    return tt.header != 0;
+}
+
+void tt_new_search(void)
+{
+    if (tt.header)
+        atomic_fetch_add(&tt.header->generation, 1);
+}
+
+void tt_clear(void)
+{
+    if (tt.header)
+        memset(tt.buckets, 0, (tt.bucket_mask + 1) * sizeof(tt_bucket_t));
+}
+
+bool tt_probe(uint64_t key, tt_hit_t *hit)
+{
+    if (!tt.buckets)
+        return false;
+
+    tt_bucket_t *bucket = &tt.buckets[key & tt.bucket_mask];
+    for (uint32_t i = 0; i < ENTRIES_PER_BUCKET; ++i) {
+        tt_entry_t *e = &bucket->entries[i];
+        uint64_t data = atomic_load_explicit(&e->data, memory_order_relaxed);
+        uint64_t check = atomic_load_explicit(&e->check, memory_order_relaxed);
+        if ((check ^ data) != key || entry_bound(data) == TT_BOUND_NONE)
+            continue;
+
+        hit->move = (move_t) { .from = (uint8_t)data, .to = (uint8_t)(data >> 8) };
+        hit->score = (int16_t)(uint16_t)(data >> 16);
+        hit->depth = entry_depth(data);
+        hit->bound = entry_bound(data);
+        hit->foreign = entry_owner(data) != tt.owner;
+        return true;
+    }
+    return false;
+}
+
+void tt_store(uint64_t key, move_t move, int score, int depth, uint8_t bound)
+{
+    if (!tt.buckets)
+        return;
+
+    const uint32_t generation = atomic_load_explicit(&tt.header->generation, memory_order_relaxed) & GENERATION_MASK;
+    tt_bucket_t *bucket = &tt.buckets[key & tt.bucket_mask];
+
+    // Prefer the slot of the same position, then the shallowest and oldest entry
+    tt_entry_t *replace = 0;
+    int replace_worth = INT32_MAX;
+    for (uint32_t i = 0; i < ENTRIES_PER_BUCKET; ++i) {
+        tt_entry_t *e = &bucket->entries[i];
+        uint64_t data = atomic_load_explicit(&e->data, memory_order_relaxed);
+        uint64_t check = atomic_load_explicit(&e->check, memory_order_relaxed);
+        if ((check ^ data) == key) {
+            // Keep deeper results of the same position unless they are stale
+            if (bound != TT_BOUND_EXACT && depth + 2 < entry_depth(data) && entry_generation(data) == generation)
+                return;
+            // Keep the known best move when this result has none
+            if (move.from == 0 && move.to == 0)
+                move = (move_t) { .from = (uint8_t)data, .to = (uint8_t)(data >> 8) };
+            replace = e;
+            break;
+        }
+        int age = (int)((generation - entry_generation(data)) & GENERATION_MASK);
+        int worth = entry_bound(data) == TT_BOUND_NONE ? INT32_MIN : entry_depth(data) - age * 8;
+        if (worth < replace_worth) {
+            replace_worth = worth;
+            replace = e;
+        }
+    }
+
+    uint64_t data = pack_entry(move, score, depth, bound, generation, tt.owner);
+    atomic_store_explicit(&replace->data, data, memory_order_relaxed);
+    atomic_store_explicit(&replace->check, key ^ data, memory_order_relaxed);
+}
+
+tt_stats_t tt_get_stats(void)
+{
+    tt_stats_t stats = { 0 };
+    stats.num_entries = tt.header ? (tt.bucket_mask + 1) * ENTRIES_PER_BUCKET : 0;
+    stats.num_attached_processes = tt.header ? atomic_load(&tt.header->num_attached) : 0;
+    stats.shared = tt.shared;
+    return stats;
+}
+
+uint64_t board_hash(const board_component_t *board)
+{
+    uint64_t key = 0;
+    for (int i = 0; i < 128; ++i) {
+        uint8_t piece = board->indices[i];
+        if (piece != 0 && !(i & 0x88))
+            key ^= zobrist.pieces[piece & 0xf][i];
+    }
+    key ^= zobrist.castle[board->castle_bits & 0xf];
+    key ^= zobrist.en_passant[board->en_passant_pos & 0x7f];
+    if (board->current_player == PIECE_BLACK)
+        key ^= zobrist.black_to_move;
+    return key;
+}
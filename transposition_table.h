@@ -0,0 +1,81 @@
+#pragma once
+#include "foundation/basic.h"
+#include "rules.h"
+
+enum {
+    TT_BOUND_NONE,
+    TT_BOUND_EXACT,
+    // Score is at most the stored value (failed low)
+    TT_BOUND_UPPER,
+    // Score is at least the stored value (failed high)
+    TT_BOUND_LOWER,
+};
+
+typedef struct tt_hit_t {
+    move_t move;
+    int score;
+    int depth;
+    uint8_t bound;
+    // True if another process stored the entry
+    bool foreign;
+} tt_hit_t;
+
+// Probes and hits are counted by each search, see `search_stats_t`
+typedef struct tt_stats_t {
+    uint64_t num_entries;
+    uint32_t num_attached_processes;
+    bool shared;
+} tt_stats_t;
+
+// Allocates a table private to this process. Replaces any previous table,
+// so no search may be running.
+bool tt_init(uint32_t size_mb);
+// Creates or attaches to the named POSIX shared memory segment (e.g.
+// "/chess3d_tt") so cooperating engine processes share one table. The size
+// is taken from the existing segment when attaching.
+bool tt_init_shared(const char *name, uint32_t size_mb);
+// Detaches; the last process to leave a shared table removes the segment.
+void tt_shutdown(void);
+
+bool tt_is_ready(void);
+// Ages existing entries so they are replaced first
+void tt_new_search(void);
+void tt_clear(void);
+
+bool tt_probe(uint64_t key, tt_hit_t *hit);
+void tt_store(uint64_t key, move_t move, int score, int depth, uint8_t bound);
+
+tt_stats_t tt_get_stats(void);
+
+// Random keys hashed into positions. They come from a fixed seed, so hashes
+// match between processes, and are set up by `tt_init` and `tt_init_shared`.
+typedef struct zobrist_keys_t {
+    uint64_t pieces[16][128];
+    uint64_t castle[16];
+    uint64_t en_passant[128];
+    uint64_t black_to_move;
+} zobrist_keys_t;
+
+extern zobrist_keys_t zobrist;
+
+// Zobrist hash of the position, scans the whole board
+uint64_t board_hash(const board_component_t *board);
+
+// Hash of `board` right after `perform_move(board, from, to)` returned
+// `info`, from the hash `key` before the move. `piece` stood on `from`.
+static inline uint64_t hash_after_move(uint64_t key, const board_component_t *board, int from, int to, uint8_t piece, const move_info_t *info)
+{
+    key ^= zobrist.pieces[piece & 0xf][from];
+    if (info->capture)
+        key ^= zobrist.pieces[info->capture & 0xf][info->capture_pos];
+    // Differs from `piece` after a promotion
+    key ^= zobrist.pieces[board->indices[to] & 0xf][to];
+    if (info->move_type == MOVE_TYPE_CASTLE) {
+        const int rook_to = from + (from > to ? -1 : 1);
+        const uint8_t rook = board->indices[rook_to] & 0xf;
+        key ^= zobrist.pieces[rook][info->rook_pos] ^ zobrist.pieces[rook][rook_to];
+    }
+    key ^= zobrist.castle[info->last_castle_bits & 0xf] ^ zobrist.castle[board->castle_bits & 0xf];
+    key ^= zobrist.en_passant[info->last_en_passant_pos & 0x7f] ^ zobrist.en_passant[board->en_passant_pos & 0x7f];
+    return key ^ zobrist.black_to_move;
+}